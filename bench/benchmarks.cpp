@@ -0,0 +1,347 @@
+// Build time, query latency and throughput, and memory of the hierarchy on
+// generated polygons. Google Benchmark flags apply, e.g.
+//    kirkpatrick_bench --benchmark_filter=star --benchmark_format=json
+//    kirkpatrick_bench --benchmark_out=results.json --benchmark_out_format=json
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "atlas.h"
+#include "kirkpatrick.h"
+#include "polygon_generators.h"
+
+namespace {
+
+size_t const query_count = 1 << 16;
+
+// Peak resident set of the whole process in kB, it never goes down, so it
+// only tells something about the largest structure built so far.
+double max_rss_kb() {
+#if defined(__unix__) || defined(__APPLE__)
+   rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+   return double(usage.ru_maxrss) / 1024;
+#else
+   return double(usage.ru_maxrss);
+#endif
+#else
+   return 0;
+#endif
+}
+
+// Hierarchies are built once per shape and size and shared by the query runs.
+flat_dag_type const& dag_for(polygon_shape shape, size_t n) {
+   static std::map<std::pair<polygon_shape, size_t>, flat_dag_type> cache;
+   auto it = cache.find(std::make_pair(shape, n));
+   if(it == cache.end()) {
+      flat_dag_type dag = kirkpatrick_type(make_polygon(shape, n)).dag();
+      it = cache.emplace(std::make_pair(shape, n), dag).first;
+   }
+   return it->second;
+}
+
+void build(benchmark::State& state, polygon_shape shape, size_t threads) {
+   size_t const n = size_t(state.range(0));
+   point_arr const polygon = make_polygon(shape, n);
+   build_options options;
+   options.threads = threads;
+   size_t nodes = 0, bytes = 0;
+   for(auto _: state) {
+      kirkpatrick_type k(polygon, options);
+      nodes = k.dag().size();
+      bytes = k.dag().bytes();
+      benchmark::DoNotOptimize(nodes);
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * polygon.size()));
+   state.counters["vertices"] = double(polygon.size());
+   state.counters["dag_nodes"] = double(nodes);
+   state.counters["dag_bytes"] = double(bytes);
+   state.counters["max_rss_kb"] = max_rss_kb();
+}
+
+// One point at a time, reports the mean latency per query.
+void query(benchmark::State& state, polygon_shape shape, query_distribution dist) {
+   size_t const n = size_t(state.range(0));
+   flat_dag_type const& dag = dag_for(shape, n);
+   point_arr const pts = make_queries(make_polygon(shape, n), dist, query_count);
+   size_t i = 0, inside = 0;
+   for(auto _: state) {
+      inside += dag.query(pts[i]);
+      if(++i == pts.size()) i = 0;
+   }
+   benchmark::DoNotOptimize(inside);
+   state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// The same stream through a query_cursor, each point starts where the
+// last one ended. Reports the share answered without a full descent.
+void query_cursor_stream(benchmark::State& state, polygon_shape shape, query_distribution dist) {
+   size_t const n = size_t(state.range(0));
+   flat_dag_type const& dag = dag_for(shape, n);
+   point_arr const pts = make_queries(make_polygon(shape, n), dist, query_count);
+   query_cursor cursor;
+   size_t i = 0, inside = 0;
+   for(auto _: state) {
+      inside += dag.query(pts[i], cursor);
+      if(++i == pts.size()) i = 0;
+   }
+   benchmark::DoNotOptimize(inside);
+   state.SetItemsProcessed(int64_t(state.iterations()));
+   state.counters["walked"] = double(cursor.walked) / double(cursor.walked + cursor.descended);
+}
+
+// Whole batches through the SIMD path, reports points per second.
+void query_batch(benchmark::State& state, polygon_shape shape, query_distribution dist) {
+   size_t const n = size_t(state.range(0));
+   flat_dag_type const& dag = dag_for(shape, n);
+   point_arr const pts = make_queries(make_polygon(shape, n), dist, query_count);
+   std::vector<uint8_t> out(pts.size());
+   for(auto _: state) {
+      dag.query_batch(pts.data(), pts.size(), out.data());
+      benchmark::DoNotOptimize(out.data());
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * pts.size()));
+}
+
+// Many maps in one process: each query goes to a random one of maps
+// hierarchies whose images add up to far more than the last level cache,
+// so most nodes of a descent come from memory. Compares the node layouts.
+void query_cold(benchmark::State& state, node_layout layout) {
+   size_t const n = size_t(state.range(0)), maps = size_t(state.range(1));
+   // Only the maps of the latest arguments are kept, they are large.
+   static std::tuple<size_t, size_t, node_layout> key;
+   static std::vector<flat_dag_type> dags;
+   static std::vector<point_arr> pts;
+   if(dags.empty() || key != std::make_tuple(n, maps, layout)) {
+      dags.clear();
+      pts.clear();
+      build_options options;
+      options.layout = layout;
+      for(size_t m = 0; m != maps; ++m) {
+         point_arr const polygon = make_polygon(polygon_shape::star, n, uint32_t(m + 1));
+         dags.push_back(kirkpatrick_type(polygon, options).dag());
+         pts.push_back(make_queries(polygon, query_distribution::uniform, 1024));
+      }
+      key = std::make_tuple(n, maps, layout);
+   }
+   std::mt19937 gen(1);
+   std::vector<std::pair<uint32_t, uint32_t> > order(query_count);
+   for(auto& o: order) o = std::make_pair(uint32_t(gen() % maps), uint32_t(gen() % 1024));
+   size_t i = 0, inside = 0;
+   for(auto _: state) {
+      inside += dags[order[i].first].query(pts[order[i].first][order[i].second]);
+      if(++i == order.size()) i = 0;
+   }
+   benchmark::DoNotOptimize(inside);
+   size_t bytes = 0;
+   for(auto const& dag: dags) bytes += dag.bytes();
+   state.SetItemsProcessed(int64_t(state.iterations()));
+   state.counters["total_bytes"] = double(bytes);
+}
+
+// Independent set selections compared on (n, max_degree): the hierarchy
+// they build and the work of a query on it. Times uniform batches.
+void strategy(benchmark::State& state, polygon_shape shape, independent_set_method method) {
+   size_t const n = size_t(state.range(0));
+   point_arr const polygon = make_polygon(shape, n);
+   build_options options;
+   options.independent_set = method;
+   options.max_degree = size_t(state.range(1));
+   kirkpatrick_type const k(polygon, options);
+   point_arr const pts = make_queries(polygon, query_distribution::uniform, query_count);
+   std::vector<uint8_t> out(pts.size());
+   for(auto _: state) {
+      k.query_batch(pts.data(), pts.size(), out.data());
+      benchmark::DoNotOptimize(out.data());
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * pts.size()));
+   build_profile const& profile = k.profile();
+   double build = profile.triangulation + profile.freeze;
+   for(auto const& l: profile.levels) build += l.seconds;
+   dag_shape const shape_of_dag = k.dag().shape();
+   query_stats st;
+   size_t orientations = 0;
+   for(auto const& pt: pts) {
+      k.dag().locate(pt, st);
+      orientations += st.orientations;
+   }
+   state.counters["levels"] = double(profile.levels.size());
+   state.counters["dag_nodes"] = double(shape_of_dag.triangles);
+   state.counters["children"] = shape_of_dag.mean_fan_out();
+   state.counters["orientations"] = double(orientations) / pts.size();
+   state.counters["build_ms"] = build * 1e3;
+}
+
+// Subdivisions of n zones, one hierarchy for all of them.
+void build_zones(benchmark::State& state) {
+   std::vector<point_arr> const zones = make_zones(size_t(state.range(0)));
+   size_t nodes = 0;
+   for(auto _: state) {
+      kirkpatrick_type k(zones);
+      nodes = k.dag().size();
+      benchmark::DoNotOptimize(nodes);
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * zones.size()));
+   state.counters["dag_nodes"] = double(nodes);
+}
+
+void locate_zones(benchmark::State& state) {
+   std::vector<point_arr> const zones = make_zones(size_t(state.range(0)));
+   kirkpatrick_type const k(zones);
+   point_arr boundary;
+   for(auto const& zone: zones) boundary.insert(boundary.end(), zone.begin(), zone.end());
+   point_arr const pts = make_queries(boundary, query_distribution::uniform, query_count);
+   std::vector<region_id> out(pts.size());
+   for(auto _: state) {
+      k.locate_batch(pts.data(), pts.size(), out.data());
+      benchmark::DoNotOptimize(out.data());
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * pts.size()));
+}
+
+// Bounding box of all the zones.
+void frame_of(std::vector<point_arr> const& zones, point_type& min, point_type& max) {
+   min = max = zones.front().front();
+   for(auto const& zone: zones) {
+      for(auto const& pt: zone) {
+         min = point_type(std::min(min.x, pt.x), std::min(min.y, pt.y));
+         max = point_type(std::max(max.x, pt.x), std::max(max.y, pt.y));
+      }
+   }
+}
+
+// The zones as separate polygons in one atlas, framed by the box of all
+// of them. separate_nodes and separate_bytes are those of a plain build
+// per zone, for comparison.
+void build_atlas(benchmark::State& state) {
+   std::vector<point_arr> const zones = make_zones(size_t(state.range(0)));
+   point_type min, max;
+   frame_of(zones, min, max);
+   size_t nodes = 0, bytes = 0;
+   for(auto _: state) {
+      polygon_atlas_type const atlas(min, max, zones);
+      nodes = 0;
+      for(size_t id = 0; id != atlas.size(); ++id) nodes += atlas.dag(region_id(id)).size();
+      bytes = atlas.bytes();
+      benchmark::DoNotOptimize(nodes);
+   }
+   size_t separate_nodes = 0, separate_bytes = 0;
+   for(auto const& zone: zones) {
+      kirkpatrick_type const k(zone);
+      separate_nodes += k.dag().size();
+      separate_bytes += k.dag().bytes();
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * zones.size()));
+   state.counters["dag_nodes"] = double(nodes);
+   state.counters["bytes"] = double(bytes);
+   state.counters["separate_nodes"] = double(separate_nodes);
+   state.counters["separate_bytes"] = double(separate_bytes);
+}
+
+void locate_atlas(benchmark::State& state) {
+   std::vector<point_arr> const zones = make_zones(size_t(state.range(0)));
+   point_type min, max;
+   frame_of(zones, min, max);
+   polygon_atlas_type const atlas(min, max, zones);
+   point_arr boundary;
+   for(auto const& zone: zones) boundary.insert(boundary.end(), zone.begin(), zone.end());
+   point_arr const pts = make_queries(boundary, query_distribution::uniform, query_count);
+   size_t i = 0, found = 0;
+   for(auto _: state) {
+      found += atlas.locate(pts[i]) != no_region;
+      if(++i == pts.size()) i = 0;
+   }
+   benchmark::DoNotOptimize(found);
+   state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// Same batches over the star with another kernel, compares the coordinate
+// types and predicates against the default one.
+template<class Kernel>
+void query_kernel(benchmark::State& state) {
+   typedef typename Kernel::point_type kernel_point;
+   size_t const n = size_t(state.range(0));
+   point_arr const polygon = make_polygon(polygon_shape::star, n);
+   typename Kernel::point_arr points, pts;
+   for(auto const& pt: polygon) points.push_back(kernel_point(pt.x, pt.y));
+   for(auto const& pt: make_queries(polygon, query_distribution::uniform, query_count))
+      pts.push_back(kernel_point(pt.x, pt.y));
+   basic_kirkpatrick<Kernel> const k(points);
+   std::vector<uint8_t> out(pts.size());
+   for(auto _: state) {
+      k.query_batch(pts.data(), pts.size(), out.data());
+      benchmark::DoNotOptimize(out.data());
+   }
+   state.SetItemsProcessed(int64_t(state.iterations() * pts.size()));
+   state.counters["dag_bytes"] = double(k.dag().bytes());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+   benchmark::Initialize(&argc, argv);
+   benchmark::AddCustomContext("simd_level", to_string(detect_simd_level()));
+   for(auto shape: all_shapes()) {
+      std::string const s = to_string(shape);
+      benchmark::RegisterBenchmark(("build/" + s).c_str(), build, shape, size_t(1))
+         ->RangeMultiplier(10)->Range(10, 1000000)->Unit(benchmark::kMillisecond);
+      benchmark::RegisterBenchmark(("build_parallel/" + s).c_str(), build, shape, size_t(0))
+         ->RangeMultiplier(10)->Range(10000, 1000000)->Unit(benchmark::kMillisecond);
+      for(auto dist: { query_distribution::uniform, query_distribution::boundary,
+                       query_distribution::trajectory }) {
+         std::string const d = to_string(dist);
+         benchmark::RegisterBenchmark(("query/" + s + "/" + d).c_str(), query, shape, dist)
+            ->RangeMultiplier(10)->Range(10, 1000000);
+         benchmark::RegisterBenchmark(("query_batch/" + s + "/" + d).c_str(), query_batch,
+               shape, dist)->RangeMultiplier(10)->Range(10, 1000000)
+            ->Unit(benchmark::kMillisecond);
+      }
+      for(auto dist: { query_distribution::uniform, query_distribution::trajectory }) {
+         benchmark::RegisterBenchmark(("query_cursor/" + s + "/" + to_string(dist)).c_str(),
+               query_cursor_stream, shape, dist)->RangeMultiplier(10)->Range(10, 1000000);
+      }
+   }
+   for(auto layout: { node_layout::depth_first, node_layout::breadth_first,
+                      node_layout::van_emde_boas }) {
+      benchmark::RegisterBenchmark((std::string("query_cold/") + to_string(layout)).c_str(),
+            query_cold, layout)->Args({ 10000, 128 })->Args({ 100000, 12 });
+   }
+   for(auto shape: all_shapes()) {
+      for(auto method: { independent_set_method::scan, independent_set_method::min_degree,
+                         independent_set_method::randomized }) {
+         std::string const name = std::string("strategy/") + to_string(shape) + "/" +
+               to_string(method);
+         auto* b = benchmark::RegisterBenchmark(name.c_str(), strategy, shape, method)
+            ->Unit(benchmark::kMillisecond);
+         for(int64_t n: { 10000, 100000 }) {
+            for(int64_t degree: { 6, 8, 12 }) b->Args({ n, degree });
+         }
+      }
+   }
+   benchmark::RegisterBenchmark("build/zones", build_zones)
+      ->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+   benchmark::RegisterBenchmark("locate_batch/zones", locate_zones)
+      ->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+   benchmark::RegisterBenchmark("build/atlas", build_atlas)
+      ->RangeMultiplier(10)->Range(10, 10000)->Unit(benchmark::kMillisecond);
+   benchmark::RegisterBenchmark("locate/atlas", locate_atlas)->RangeMultiplier(10)->Range(10, 10000);
+#define REGISTER_KERNEL(K) \
+   benchmark::RegisterBenchmark("query_kernel/" #K, query_kernel<K>) \
+      ->RangeMultiplier(10)->Range(1000, 100000)->Unit(benchmark::kMillisecond);
+   KIRKPATRICK_FOR_EACH_KERNEL(REGISTER_KERNEL)
+   benchmark::RunSpecifiedBenchmarks();
+   benchmark::Shutdown();
+   return 0;
+}
@@ -0,0 +1,353 @@
+// Load generator of the query server: keeps connections busy with pipelined
+// query requests and reports throughput and the latency of the batches.
+//
+//    kirkpatrick_loadgen --write poly.txt
+//    kirkpatrick_cli --serve /tmp/kirkpatrick.sock poly.txt &
+//    kirkpatrick_loadgen --connections 4 --check --reload 50 /tmp/kirkpatrick.sock
+//
+// The polygon is one of the generated ones, the same for the same --shape
+// and --vertices, so --check can compare the answers with a local build.
+// That only holds while reloads serve the same polygon.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "kirkpatrick.h"
+#include "polygon_generators.h"
+#include "protocol.h"
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+
+void usage() {
+   std::fprintf(stderr,
+         "usage: kirkpatrick_loadgen [options] SOCKET\n"
+         "       kirkpatrick_loadgen [options] --write FILE\n"
+         "options:\n"
+         "   --shape NAME       star, spiral, comb or reflex (default star)\n"
+         "   --vertices N       of the polygon (default 10000)\n"
+         "   --write FILE       store the polygon for the server and exit\n"
+         "   --queries N        points in all (default 4194304)\n"
+         "   --batch N          points per request (default 4096)\n"
+         "   --window N         requests in flight per connection (default 8)\n"
+         "   --connections N    (default 1)\n"
+         "   --boundary         points close to the edges instead of the bounding box\n"
+         "   --locate           ask for region ids instead of 0/1\n"
+         "   --check            compare the answers with a local build\n"
+         "   --reload MS        send a reload every MS milliseconds on a connection of its own\n"
+         "   --reload-path FILE what the reloads load, the server's own files by default;\n"
+         "                      the server must allow it with --allow-reload\n");
+}
+
+struct options {
+   polygon_shape shape = polygon_shape::star;
+   size_t vertices = 10000;
+   size_t queries = size_t(1) << 22;
+   size_t batch = 4096;
+   size_t window = 8;
+   size_t connections = 1;
+   query_distribution distribution = query_distribution::uniform;
+   bool locate = false;
+   bool check = false;
+   unsigned reload_ms = 0;
+   std::string reload_path;
+};
+
+int connect_to(std::string const& path) {
+   sockaddr_un addr;
+   std::memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if(path.size() >= sizeof(addr.sun_path))
+      throw std::runtime_error("socket path too long: " + path);
+   std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(fd < 0 || connect(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0) {
+      if(fd >= 0) close(fd);
+      throw std::runtime_error("cannot connect to " + path);
+   }
+   return fd;
+}
+
+// Reads a response, throws on error responses and I/O errors.
+frame_header read_response(int fd, std::vector<char>& payload) {
+   frame_header h;
+   if(!read_full(fd, &h, sizeof(h)))
+      throw std::runtime_error("server closed the connection");
+   payload.resize(size_t(h.count) * item_bytes(h.type));
+   if(!payload.empty()) read_full(fd, payload.data(), payload.size());
+   if(h.type == frame_type::error)
+      throw std::runtime_error("server error: " + std::string(payload.begin(), payload.end()));
+   return h;
+}
+
+// What the connections found, merged at the end.
+struct results {
+   std::vector<double> latencies;       // of the batches, seconds
+   size_t mismatches = 0;
+   uint32_t min_generation = UINT32_MAX, max_generation = 0;
+   std::vector<std::string> errors;
+
+   void merge(results const& o) {
+      latencies.insert(latencies.end(), o.latencies.begin(), o.latencies.end());
+      mismatches += o.mismatches;
+      min_generation = std::min(min_generation, o.min_generation);
+      max_generation = std::max(max_generation, o.max_generation);
+      errors.insert(errors.end(), o.errors.begin(), o.errors.end());
+   }
+};
+
+// Sends the batches first, first + step, ... on one connection, at most
+// window of them unanswered. A thread of its own writes the requests,
+// the calling one reads the responses.
+struct connection_run {
+   options const& opt;
+   point_arr const& points;
+   std::vector<int32_t> const& expected;      // answers of a local build, or none
+   results res;
+
+   void run(std::string const& socket_path, size_t first, size_t step) {
+      int const fd = connect_to(socket_path);
+      std::vector<size_t> batches;
+      size_t const count = (points.size() + opt.batch - 1) / opt.batch;
+      for(size_t b = first; b < count; b += step) batches.push_back(b);
+      // Send times by position in batches. Responses come in order and at
+      // most window batches are in flight, so they never share a slot.
+      std::vector<clock_type::time_point> sent(opt.window);
+      std::mutex mutex;
+      std::condition_variable room;
+      size_t in_flight = 0;
+      bool failed = false;
+
+      std::thread writer([&] {
+         std::vector<char> frame;
+         try {
+            for(size_t k = 0; k != batches.size(); ++k) {
+               size_t const b = batches[k];
+               size_t const begin = b * opt.batch;
+               size_t const n = std::min(opt.batch, points.size() - begin);
+               frame_header const h = { opt.locate ? frame_type::locate : frame_type::query,
+                                        uint32_t(b), uint32_t(n), 0 };
+               frame.resize(sizeof(h) + n * sizeof(point_type));
+               std::memcpy(frame.data(), &h, sizeof(h));
+               std::memcpy(frame.data() + sizeof(h), &points[begin], n * sizeof(point_type));
+               {
+                  std::unique_lock<std::mutex> lock(mutex);
+                  room.wait(lock, [&] { return in_flight < opt.window || failed; });
+                  if(failed) return;
+                  ++in_flight;
+                  sent[k % opt.window] = clock_type::now();
+               }
+               write_full(fd, frame.data(), frame.size());
+            }
+         } catch(std::exception const& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            res.errors.push_back(e.what());
+         }
+      });
+
+      std::vector<char> payload;
+      try {
+         uint32_t last_generation = 0;
+         for(size_t k = 0; k != batches.size(); ++k) {
+            size_t const b = batches[k];
+            frame_header const h = read_response(fd, payload);
+            clock_type::time_point const now = clock_type::now();
+            if(h.tag != b || h.type != (opt.locate ? frame_type::regions : frame_type::hits))
+               throw std::runtime_error("response out of order");
+            if(h.generation < last_generation)
+               throw std::runtime_error("generation went back");
+            last_generation = h.generation;
+            res.min_generation = std::min(res.min_generation, h.generation);
+            res.max_generation = std::max(res.max_generation, h.generation);
+            if(!expected.empty()) compare(b * opt.batch, h.count, payload);
+            std::lock_guard<std::mutex> lock(mutex);
+            res.latencies.push_back(std::chrono::duration<double>(now - sent[k % opt.window]).count());
+            --in_flight;
+            room.notify_one();
+         }
+      } catch(std::exception const& e) {
+         std::lock_guard<std::mutex> lock(mutex);
+         res.errors.push_back(e.what());
+         failed = true;
+         room.notify_one();
+      }
+      shutdown(fd, SHUT_RDWR);                // unblocks a writer stuck on a dead server
+      writer.join();
+      close(fd);
+   }
+
+   void compare(size_t begin, size_t n, std::vector<char> const& payload) {
+      for(size_t i = 0; i != n; ++i) {
+         int32_t answer;
+         if(opt.locate) std::memcpy(&answer, &payload[4 * i], 4);
+         else answer = payload[i];
+         res.mismatches += answer != expected[begin + i];
+      }
+   }
+};
+
+// Sends reloads until done is set, returns their latencies.
+void reload_loop(std::string const& socket_path, options const& opt, bool const& done,
+      std::mutex& mutex, results& res) {
+   try {
+      int const fd = connect_to(socket_path);
+      std::vector<char> payload;
+      for(uint32_t tag = 0;; ++tag) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(opt.reload_ms));
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(done) break;
+         }
+         frame_header const h = { frame_type::reload, tag, uint32_t(opt.reload_path.size()), 0 };
+         clock_type::time_point const start = clock_type::now();
+         write_full(fd, &h, sizeof(h));
+         write_full(fd, opt.reload_path.data(), opt.reload_path.size());
+         frame_header const r = read_response(fd, payload);
+         if(r.type != frame_type::reloaded || r.tag != tag)
+            throw std::runtime_error("unexpected response to a reload");
+         res.latencies.push_back(std::chrono::duration<double>(clock_type::now() - start).count());
+         res.max_generation = std::max(res.max_generation, r.generation);
+      }
+      close(fd);
+   } catch(std::exception const& e) {
+      res.errors.push_back(e.what());
+   }
+}
+
+double percentile(std::vector<double> const& sorted, double p) {
+   if(sorted.empty()) return 0;
+   return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+bool parse_shape(std::string const& name, polygon_shape& shape) {
+   for(auto s: all_shapes()) {
+      if(name == to_string(s)) {
+         shape = s;
+         return true;
+      }
+   }
+   return false;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+   options opt;
+   std::string write_path;
+   std::vector<std::string> args;
+   for(int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+      if(arg == "--shape" && has_value) {
+         if(!parse_shape(argv[++i], opt.shape)) { usage(); return 2; }
+      }
+      else if(arg == "--vertices" && has_value) opt.vertices = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--write" && has_value) write_path = argv[++i];
+      else if(arg == "--queries" && has_value) opt.queries = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--batch" && has_value) opt.batch = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--window" && has_value) opt.window = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--connections" && has_value)
+         opt.connections = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--boundary") opt.distribution = query_distribution::boundary;
+      else if(arg == "--locate") opt.locate = true;
+      else if(arg == "--check") opt.check = true;
+      else if(arg == "--reload" && has_value) opt.reload_ms = unsigned(std::strtoul(argv[++i], nullptr, 10));
+      else if(arg == "--reload-path" && has_value) opt.reload_path = argv[++i];
+      else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+      else if(arg.size() > 1 && arg[0] == '-') { usage(); return 2; }
+      else args.push_back(arg);
+   }
+   if(args.size() != (write_path.empty() ? 1u : 0u) || opt.batch == 0 || opt.window == 0 ||
+         opt.connections == 0 || opt.batch > max_frame_items) {
+      usage();
+      return 2;
+   }
+
+   try {
+      point_arr const polygon = make_polygon(opt.shape, opt.vertices);
+      if(!write_path.empty()) {
+         std::ofstream ofs(write_path.c_str());
+         ofs << "1\n";
+         for(auto const& p: polygon) ofs << p << "\n";
+         ofs.close();
+         if(!ofs) throw std::runtime_error("cannot write " + write_path);
+         return 0;
+      }
+      std::signal(SIGPIPE, SIG_IGN);
+      point_arr const points = make_queries(polygon, opt.distribution, opt.queries);
+      std::vector<int32_t> expected;
+      if(opt.check) {
+         kirkpatrick_type const k(polygon);
+         expected.resize(points.size());
+         k.locate_batch(points.data(), points.size(), expected.data());
+         if(!opt.locate) {
+            for(auto& e: expected) e = e != no_region;
+         }
+      }
+
+      std::vector<connection_run> runs(opt.connections,
+            connection_run{ opt, points, expected, results() });
+      bool done = false;
+      std::mutex reload_mutex;
+      results reloads;
+      std::thread reloader;
+      if(opt.reload_ms) {
+         reloader = std::thread(reload_loop, std::cref(args[0]), std::cref(opt), std::cref(done),
+               std::ref(reload_mutex), std::ref(reloads));
+      }
+      clock_type::time_point const start = clock_type::now();
+      std::vector<std::thread> threads;
+      for(size_t c = 0; c != opt.connections; ++c)
+         threads.emplace_back(&connection_run::run, &runs[c], std::cref(args[0]), c, opt.connections);
+      for(auto& t: threads) t.join();
+      double const seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+      if(reloader.joinable()) {
+         {
+            std::lock_guard<std::mutex> lock(reload_mutex);
+            done = true;
+         }
+         reloader.join();
+      }
+
+      results all;
+      for(auto const& r: runs) all.merge(r.res);
+      std::sort(all.latencies.begin(), all.latencies.end());
+      std::printf("%zu points in %zu batches of %zu over %zu connections, window %zu: "
+            "%.3f s, %.2f M points/s\n", points.size(), all.latencies.size(), opt.batch,
+            opt.connections, opt.window, seconds, points.size() / seconds * 1e-6);
+      std::printf("batch latency p50 %.0f us, p99 %.0f us, max %.0f us\n",
+            percentile(all.latencies, 0.5) * 1e6, percentile(all.latencies, 0.99) * 1e6,
+            (all.latencies.empty() ? 0 : all.latencies.back()) * 1e6);
+      if(opt.reload_ms) {
+         double total = 0;
+         for(double l: reloads.latencies) total += l;
+         std::printf("%zu reloads, %.1f ms each; answers from generations %u to %u\n",
+               reloads.latencies.size(),
+               reloads.latencies.empty() ? 0 : total / reloads.latencies.size() * 1e3,
+               all.min_generation, all.max_generation);
+      }
+      if(opt.check) std::printf("%zu mismatches\n", all.mismatches);
+      all.merge(reloads);
+      for(auto const& e: all.errors) std::fprintf(stderr, "kirkpatrick_loadgen: %s\n", e.c_str());
+      return all.errors.empty() && all.mismatches == 0 ? 0 : 1;
+   } catch(std::exception const& e) {
+      std::fprintf(stderr, "kirkpatrick_loadgen: %s\n", e.what());
+      return 1;
+   }
+}
@@ -0,0 +1,215 @@
+#include "polygon_generators.h"
+
+#include <cmath>
+#include <random>
+
+namespace {
+
+double const pi = 3.14159265358979323846;
+
+point_type round_point(double x, double y) {
+   return point_type(int32_t(std::lround(x)), int32_t(std::lround(y)));
+}
+
+// Angles are jittered inside their own slice, so they stay sorted.
+point_arr star(size_t n, uint32_t seed) {
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<double> jitter(0, 0.5), radius(1, 2);
+   double const scale = std::max<double>(n, 64);
+   point_arr res;
+   for(size_t i = 0; i != n; ++i) {
+      double a = 2 * pi * (i + jitter(gen)) / n;
+      double r = scale * radius(gen);
+      res.push_back(round_point(r * std::cos(a), r * std::sin(a)));
+   }
+   return res;
+}
+
+point_arr reflex(size_t n, uint32_t seed) {
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<double> jitter(0.9, 1.1);
+   double const scale = std::max<double>(n, 64);
+   point_arr res;
+   for(size_t i = 0; i != n; ++i) {
+      double a = 2 * pi * i / n;
+      double r = scale * (i % 2 ? 0.2 : jitter(gen));
+      res.push_back(round_point(r * std::cos(a), r * std::sin(a)));
+   }
+   return res;
+}
+
+// Archimedean spiral r = r0 + b * t, sampled at equal arc length. The
+// outer edge goes out, the inner one, half a pitch closer to the
+// centre, comes back.
+point_arr spiral(size_t n) {
+   size_t const m = std::max<size_t>(n / 2, 3);
+   double const turns = std::max(0.5, std::sqrt(double(n)) / 8);
+   double const t_max = 2 * pi * turns;
+   double const step = 4;                            // units between samples
+   double const b = 2 * step * m / (t_max * t_max);
+   double const r0 = 2 * pi * b;                     // one pitch
+   double const width = pi * b;                      // half a pitch
+   point_arr res(2 * m);
+   for(size_t i = 0; i != m; ++i) {
+      double t = t_max * std::sqrt(double(i) / (m - 1));
+      double r = r0 + b * t;
+      res[i] = round_point(r * std::cos(t), r * std::sin(t));
+      res[2 * m - 1 - i] = round_point((r - width) * std::cos(t), (r - width) * std::sin(t));
+   }
+   return res;
+}
+
+// Teeth are 2 units wide with 2 unit gaps, the base runs below them.
+point_arr comb(size_t n) {
+   int32_t const k = int32_t(std::max<size_t>(n / 4, 1));
+   int32_t const h = 64;
+   point_arr res;
+   res.push_back(point_type(0, -4));
+   res.push_back(point_type(4 * k - 2, -4));
+   for(int32_t i = k - 1; i >= 0; --i) {
+      res.push_back(point_type(4 * i + 2, h));
+      res.push_back(point_type(4 * i, h));
+      if(i == 0) break;
+      res.push_back(point_type(4 * i, 0));
+      res.push_back(point_type(4 * i - 2, 0));
+   }
+   return res;
+}
+
+} // namespace
+
+char const* to_string(polygon_shape shape) {
+   switch(shape) {
+   case polygon_shape::star: return "star";
+   case polygon_shape::spiral: return "spiral";
+   case polygon_shape::comb: return "comb";
+   case polygon_shape::reflex: return "reflex";
+   }
+   return "?";
+}
+
+std::vector<polygon_shape> all_shapes() {
+   return { polygon_shape::star, polygon_shape::spiral, polygon_shape::comb,
+            polygon_shape::reflex };
+}
+
+point_arr make_polygon(polygon_shape shape, size_t n, uint32_t seed) {
+   switch(shape) {
+   case polygon_shape::star: return star(n, seed);
+   case polygon_shape::spiral: return spiral(n);
+   case polygon_shape::comb: return comb(n);
+   case polygon_shape::reflex: return reflex(n, seed);
+   }
+   return point_arr();
+}
+
+std::vector<point_arr> make_zones(size_t n, uint32_t seed) {
+   std::mt19937 gen(seed);
+   std::uniform_int_distribution<int32_t> corner(-6, 6), bend(-3, 3);
+   std::uniform_real_distribution<double> keep(0, 1);
+   size_t const k = size_t(std::ceil(std::sqrt(n * 10.0 / 9))) + 1;
+   int32_t const step = 32;
+   auto id = [k](size_t i, size_t j) { return j * (k + 1) + i; };
+   point_arr corners((k + 1) * (k + 1));
+   for(size_t j = 0; j != k + 1; ++j) {
+      for(size_t i = 0; i != k + 1; ++i)
+         corners[id(i, j)] = point_type(int32_t(i) * step + corner(gen),
+                                        int32_t(j) * step + corner(gen));
+   }
+   // Two bends per lattice edge, from the lower corner to the higher one.
+   auto bends = [&](point_type const& a, point_type const& b, bool horizontal) {
+      point_arr res;
+      for(double t: { 1.0 / 3, 2.0 / 3 }) {
+         int32_t d = bend(gen);
+         res.push_back(round_point(a.x + t * (b.x - a.x) + (horizontal ? 0 : d),
+                                   a.y + t * (b.y - a.y) + (horizontal ? d : 0)));
+      }
+      return res;
+   };
+   std::vector<point_arr> horizontal((k + 1) * (k + 1)), vertical((k + 1) * (k + 1));
+   for(size_t j = 0; j != k + 1; ++j) {
+      for(size_t i = 0; i != k + 1; ++i) {
+         if(i != k) horizontal[id(i, j)] = bends(corners[id(i, j)], corners[id(i + 1, j)], true);
+         if(j != k) vertical[id(i, j)] = bends(corners[id(i, j)], corners[id(i, j + 1)], false);
+      }
+   }
+   std::vector<point_arr> res;
+   for(size_t j = 0; j != k && res.size() != n; ++j) {
+      for(size_t i = 0; i != k && res.size() != n; ++i) {
+         if(keep(gen) < 0.1) continue;
+         point_arr cell;                  // counter-clockwise from the lower left corner
+         auto const& bottom = horizontal[id(i, j)];
+         auto const& right = vertical[id(i + 1, j)];
+         auto const& top = horizontal[id(i, j + 1)];
+         auto const& left = vertical[id(i, j)];
+         cell.push_back(corners[id(i, j)]);
+         cell.insert(cell.end(), bottom.begin(), bottom.end());
+         cell.push_back(corners[id(i + 1, j)]);
+         cell.insert(cell.end(), right.begin(), right.end());
+         cell.push_back(corners[id(i + 1, j + 1)]);
+         cell.insert(cell.end(), top.rbegin(), top.rend());
+         cell.push_back(corners[id(i, j + 1)]);
+         cell.insert(cell.end(), left.rbegin(), left.rend());
+         res.push_back(cell);
+      }
+   }
+   return res;
+}
+
+char const* to_string(query_distribution dist) {
+   switch(dist) {
+   case query_distribution::uniform: return "uniform";
+   case query_distribution::boundary: return "boundary";
+   case query_distribution::trajectory: return "trajectory";
+   }
+   return "?";
+}
+
+point_arr make_queries(point_arr const& polygon, query_distribution dist, size_t count,
+      uint32_t seed) {
+   std::mt19937 gen(seed);
+   point_arr res;
+   res.reserve(count);
+   point_type lo = polygon.front(), hi = polygon.front();
+   for(auto const& p: polygon) {
+      lo = point_type(std::min(lo.x, p.x), std::min(lo.y, p.y));
+      hi = point_type(std::max(hi.x, p.x), std::max(hi.y, p.y));
+   }
+   if(dist == query_distribution::uniform) {
+      std::uniform_int_distribution<int32_t> x(lo.x, hi.x), y(lo.y, hi.y);
+      for(size_t i = 0; i != count; ++i) res.push_back(point_type(x(gen), y(gen)));
+   } else if(dist == query_distribution::trajectory) {
+      // Steps of a 4096th of the box with a slowly turning heading, turned
+      // back into the box at its sides.
+      double const w = double(hi.x) - lo.x, h = double(hi.y) - lo.y;
+      double const step = std::max(w, h) / 4096;
+      std::uniform_real_distribution<double> turn(-0.2, 0.2);
+      double x = lo.x + w / 2, y = lo.y + h / 2, heading = 0;
+      for(size_t i = 0; i != count; ++i) {
+         heading += turn(gen);
+         x += step * std::cos(heading);
+         y += step * std::sin(heading);
+         if(x < lo.x || hi.x < x) {
+            heading = pi - heading;
+            x = std::min<double>(std::max<double>(x, lo.x), hi.x);
+         }
+         if(y < lo.y || hi.y < y) {
+            heading = -heading;
+            y = std::min<double>(std::max<double>(y, lo.y), hi.y);
+         }
+         res.push_back(round_point(x, y));
+      }
+   } else {
+      std::uniform_int_distribution<size_t> edge(0, polygon.size() - 1);
+      std::uniform_real_distribution<double> along(0, 1), offset(-2, 2);
+      for(size_t i = 0; i != count; ++i) {
+         size_t e = edge(gen);
+         point_type const& a = polygon[e];
+         point_type const& b = polygon[(e + 1) % polygon.size()];
+         double t = along(gen);
+         res.push_back(round_point(a.x + t * (b.x - a.x) + offset(gen),
+                                   a.y + t * (b.y - a.y) + offset(gen)));
+      }
+   }
+   return res;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// Synthetic simple polygons for the benchmarks. All of them are
+// counter-clockwise, have integer coordinates and are the same for the same
+// arguments. The scale grows with n so that neighbouring vertices stay a
+// few units apart.
+
+enum class polygon_shape {
+   star,              // random radius per vertex, star-shaped around the origin
+   spiral,            // a band wound around the origin
+   comb,              // a row of thin teeth
+   reflex             // star with alternating long and short spikes
+};
+
+char const* to_string(polygon_shape);
+std::vector<polygon_shape> all_shapes();
+point_arr make_polygon(polygon_shape, size_t n, uint32_t seed = 1);
+
+// Jittered grid of n quadrilateral zones with bent edges. Neighbours share
+// their edges and vertices, about one cell in ten is left out. Region i of
+// a subdivision is the i-th ring.
+std::vector<point_arr> make_zones(size_t n, uint32_t seed = 1);
+
+enum class query_distribution {
+   uniform,           // bounding box of the polygon
+   boundary,          // within a couple of units of an edge
+   trajectory         // a track through the bounding box in small steps, like GPS fixes
+};
+
+char const* to_string(query_distribution);
+point_arr make_queries(point_arr const& polygon, query_distribution, size_t count,
+      uint32_t seed = 2);
@@ -22,15 +22,40 @@ INCLUDEPATH += src \
                Geometry-Visualization-Library/src \
                "C:\Program Files\boost\boost_1_75_0" \
 
-HEADERS += src/graph.h \
+HEADERS += src/arena.h \
+           src/atlas.h \
+           src/batch_kernel.h \
+           src/editable.h \
+           src/flat_dag.h \
+           src/graph.h \
+           src/kernel.h \
            src/kirkpatrick.h \
+           src/mapped_file.h \
+           src/point_grid.h \
+           src/predicates.h \
+           src/query_engine.h \
+           src/stats.h \
+           src/subdivision.h \
+           src/thread_pool.h \
+           src/trace.h \
            src/triangle.h \
            src/util.h \
            src/viewer.h \
 
-SOURCES += src/graph.cpp \
+SOURCES += src/arena.cpp \
+           src/atlas.cpp \
+           src/batch_kernel.cpp \
+           src/editable.cpp \
+           src/flat_dag.cpp \
+           src/graph.cpp \
            src/main.cpp \
            src/kirkpatrick.cpp \
+           src/mapped_file.cpp \
+           src/point_grid.cpp \
+           src/query_engine.cpp \
+           src/subdivision.cpp \
+           src/thread_pool.cpp \
+           src/trace.cpp \
            src/triangle.cpp \
            src/viewer.cpp \
 
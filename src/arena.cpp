@@ -0,0 +1,26 @@
+#include "arena.h"
+
+build_arena::build_arena(size_t workers) {
+   add_workers(workers);
+}
+
+void build_arena::add_workers(size_t workers) {
+   while(_threads.size() < workers + 1)
+      _threads.emplace_back(new thread_arena());
+}
+
+size_t build_arena::bytes() const {
+   size_t res = 0;
+   for(auto const& t: _threads) res += t->blocks.bytes;
+   return res;
+}
+
+void* build_arena::counting_resource::do_allocate(size_t n, size_t align) {
+   bytes += n;
+   return std::pmr::new_delete_resource()->allocate(n, align);
+}
+
+void build_arena::counting_resource::do_deallocate(void* p, size_t n, size_t align) {
+   bytes -= n;
+   std::pmr::new_delete_resource()->deallocate(p, n, align);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Memory of one build, handed out from a few large blocks that are freed
+// together. std::pmr::monotonic_buffer_resource is not thread safe, so
+// there is one per thread: resource(0) for the building thread and
+// resource(w + 1) for worker w of its pool.
+// Objects made by make_shared() keep the arena alive, it goes away with
+// the last of them.
+struct build_arena: std::enable_shared_from_this<build_arena> {
+   explicit build_arena(size_t workers = 0);
+   build_arena(build_arena const&) = delete;
+   build_arena& operator=(build_arena const&) = delete;
+
+   // Makes room for a pool of workers, before they start.
+   void add_workers(size_t workers);
+   std::pmr::memory_resource* resource(size_t thread) { return &_threads[thread]->arena; }
+   template<class T, class... Args>
+   std::shared_ptr<T> make_shared(size_t thread, Args&&... args);
+   size_t bytes() const;                     // of the blocks taken so far
+private:
+   // Upstream of one monotonic resource, counts its blocks.
+   struct counting_resource: std::pmr::memory_resource {
+      size_t bytes = 0;
+   private:
+      void* do_allocate(size_t n, size_t align) override;
+      void do_deallocate(void* p, size_t n, size_t align) override;
+      bool do_is_equal(std::pmr::memory_resource const& o) const noexcept override {
+         return this == &o;
+      }
+   };
+   struct thread_arena {
+      counting_resource blocks;
+      std::pmr::monotonic_buffer_resource arena{ &blocks };
+   };
+   std::vector<std::unique_ptr<thread_arena> > _threads;
+};
+
+// Allocator of make_shared(), holds the arena for the control block.
+template<class T>
+struct arena_allocator {
+   typedef T value_type;
+
+   arena_allocator(std::shared_ptr<build_arena> arena, std::pmr::memory_resource* resource):
+      _arena(std::move(arena)), _resource(resource) { }
+   template<class U>
+   arena_allocator(arena_allocator<U> const& o): _arena(o._arena), _resource(o._resource) { }
+
+   T* allocate(size_t n) {
+      return static_cast<T*>(_resource->allocate(n * sizeof(T), alignof(T)));
+   }
+   void deallocate(T* p, size_t n) { _resource->deallocate(p, n * sizeof(T), alignof(T)); }
+
+   template<class U>
+   bool operator==(arena_allocator<U> const& o) const { return _resource == o._resource; }
+   template<class U>
+   bool operator!=(arena_allocator<U> const& o) const { return _resource != o._resource; }
+private:
+   template<class U> friend struct arena_allocator;
+   std::shared_ptr<build_arena> _arena;
+   std::pmr::memory_resource* _resource;
+};
+
+template<class T, class... Args>
+std::shared_ptr<T> build_arena::make_shared(size_t thread, Args&&... args) {
+   return std::allocate_shared<T>(arena_allocator<T>(shared_from_this(), resource(thread)),
+         std::forward<Args>(args)...);
+}
@@ -0,0 +1,138 @@
+#include "atlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+template<class Kernel>
+basic_polygon_atlas<Kernel>::basic_polygon_atlas(point_type const& min, point_type const& max,
+      size_t expected_polygons, build_options const& options):
+   _min(min), _max(max), _options(options) {
+   if(max.x < min.x || max.y < min.y)
+      throw std::invalid_argument("empty frame");
+   init_grid(expected_polygons);
+}
+
+template<class Kernel>
+basic_polygon_atlas<Kernel>::basic_polygon_atlas(point_type const& min, point_type const& max,
+      std::vector<point_arr> const& polygons, build_options const& options):
+   basic_polygon_atlas(min, max, polygons.size(), options) {
+   _polygons.resize(polygons.size());
+   build_options single = options;
+   single.threads = 1;
+   if(options.threads == 1 || polygons.size() < 2) {
+      for(size_t i = 0; i != polygons.size(); ++i)
+         _polygons[i] = build(polygons[i], min, max, single);
+   } else {
+      // The pool throws the first error once all workers are done.
+      work_stealing_pool pool(options.threads);
+      pool.run(polygons.size(), [&](size_t i, size_t) {
+         _polygons[i] = build(polygons[i], min, max, single);
+      });
+   }
+   for(size_t i = 0; i != polygons.size(); ++i) index(region_id(i));
+   KIRKPATRICK_TRACE(info, build) << "atlas of" << polygons.size() << "polygons in"
+         << _cells.size() << "cells";
+}
+
+template<class Kernel>
+typename basic_polygon_atlas<Kernel>::entry basic_polygon_atlas<Kernel>::build(
+      point_arr const& polygon, point_type const& min, point_type const& max,
+      build_options const& options) {
+   entry res;
+   if(polygon.empty())
+      throw std::invalid_argument("empty polygon");
+   res.min = res.max = polygon[0];
+   for(auto const& pt: polygon) {
+      res.min = point_type(std::min(res.min.x, pt.x), std::min(res.min.y, pt.y));
+      res.max = point_type(std::max(res.max.x, pt.x), std::max(res.max.y, pt.y));
+   }
+   res.dag = basic_kirkpatrick<Kernel>(polygon, min, max, options).dag();
+   return res;
+}
+
+template<class Kernel>
+region_id basic_polygon_atlas<Kernel>::add(point_arr const& polygon) {
+   build_options single = _options;
+   single.threads = 1;
+   _polygons.push_back(build(polygon, _min, _max, single));
+   region_id const id = region_id(_polygons.size() - 1);
+   index(id);
+   return id;
+}
+
+// Square cells, about one polygon per cell.
+template<class Kernel>
+void basic_polygon_atlas<Kernel>::init_grid(size_t expected_polygons) {
+   double const w = double(_max.x) - double(_min.x) + 1;
+   double const h = double(_max.y) - double(_min.y) + 1;
+   double const side = std::max(1.0, std::sqrt(w * h / std::max<size_t>(expected_polygons, 1)));
+   _cell_w = _cell_h = std::ceil(side);
+   _columns = size_t(std::ceil(w / _cell_w));
+   _rows = size_t(std::ceil(h / _cell_h));
+   _cells.assign(_columns * _rows, std::vector<region_id>());
+}
+
+template<class Kernel>
+size_t basic_polygon_atlas<Kernel>::column(coord_type x) const {
+   double c = std::floor((double(x) - double(_min.x)) / _cell_w);
+   if(!(c > 0)) return 0;
+   return std::min(_columns - 1, size_t(std::min(c, double(_columns))));
+}
+
+template<class Kernel>
+size_t basic_polygon_atlas<Kernel>::row(coord_type y) const {
+   double r = std::floor((double(y) - double(_min.y)) / _cell_h);
+   if(!(r > 0)) return 0;
+   return std::min(_rows - 1, size_t(std::min(r, double(_rows))));
+}
+
+template<class Kernel>
+void basic_polygon_atlas<Kernel>::index(region_id id) {
+   entry const& e = _polygons[id];
+   for(size_t r = row(e.min.y); r <= row(e.max.y); ++r) {
+      for(size_t c = column(e.min.x); c <= column(e.max.x); ++c)
+         _cells[r * _columns + c].push_back(id);
+   }
+}
+
+template<class Kernel>
+bool basic_polygon_atlas<Kernel>::query(region_id polygon, point_type const& pt) const {
+   return inside(_polygons[polygon], pt);
+}
+
+template<class Kernel>
+region_id basic_polygon_atlas<Kernel>::locate(point_type const& pt) const {
+   if(pt.x < _min.x || pt.y < _min.y || _max.x < pt.x || _max.y < pt.y)
+      return no_region;
+   for(auto id: _cells[row(pt.y) * _columns + column(pt.x)]) {
+      if(inside(_polygons[id], pt)) return id;
+   }
+   return no_region;
+}
+
+template<class Kernel>
+void basic_polygon_atlas<Kernel>::locate_all(point_type const& pt,
+      std::vector<region_id>& out) const {
+   out.clear();
+   if(pt.x < _min.x || pt.y < _min.y || _max.x < pt.x || _max.y < pt.y)
+      return;
+   for(auto id: _cells[row(pt.y) * _columns + column(pt.x)]) {
+      if(inside(_polygons[id], pt)) out.push_back(id);
+   }
+}
+
+template<class Kernel>
+size_t basic_polygon_atlas<Kernel>::bytes() const {
+   size_t res = _polygons.capacity() * sizeof(entry) + _cells.capacity() * sizeof(_cells[0]);
+   for(auto const& e: _polygons) res += e.dag.bytes();
+   for(auto const& c: _cells) res += c.capacity() * sizeof(region_id);
+   return res;
+}
+
+#define INSTANTIATE(K) template struct basic_polygon_atlas<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "kirkpatrick.h"
+
+// Many polygons inside one fixed box, say the parcels of a city. Every
+// polygon gets a hierarchy of its own, built under the outer triangle of
+// the box (see the framed basic_kirkpatrick constructor), so no hierarchy
+// carries an exterior triangulation out to a triangle of its own. A
+// uniform grid over the box routes a query to the polygons whose bounding
+// box covers its cell, only their hierarchies are descended.
+// Polygons may overlap. Const member functions may be called concurrently.
+template<class Kernel>
+struct basic_polygon_atlas {
+   typedef typename Kernel::coord_type coord_type;
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   typedef basic_flat_dag<Kernel> flat_dag_type;
+
+   // An empty box [min, max], its grid has a cell per expected polygon.
+   basic_polygon_atlas(point_type const& min, point_type const& max,
+         size_t expected_polygons = 1024, build_options const& = build_options());
+   // The polygons get the ids 0 .. polygons.size() - 1. They are built on
+   // options.threads workers, one polygon per task.
+   basic_polygon_atlas(point_type const& min, point_type const& max,
+         std::vector<point_arr> const& polygons, build_options const& = build_options());
+   // Builds one more polygon and returns its id, size() before the call.
+   // Throws std::out_of_range if it leaves the box.
+   region_id add(point_arr const& polygon);
+   size_t size() const { return _polygons.size(); }
+   // True if pt is inside polygon or on its boundary.
+   bool query(region_id polygon, point_type const& pt) const;
+   // Smallest id of a polygon containing pt, no_region if there is none.
+   region_id locate(point_type const&) const;
+   // Ids of all polygons containing pt, ascending.
+   void locate_all(point_type const&, std::vector<region_id>& out) const;
+   flat_dag_type const& dag(region_id polygon) const { return _polygons[polygon].dag; }
+   size_t bytes() const;                    // of the hierarchies and the grid
+private:
+   struct entry {
+      point_type min, max;                  // bounding box of the polygon
+      flat_dag_type dag;
+   };
+   static entry build(point_arr const& polygon, point_type const& min, point_type const& max,
+         build_options const& options);
+   void init_grid(size_t expected_polygons);
+   void index(region_id id);                // adds id to the cells under its box
+   size_t column(coord_type x) const;
+   size_t row(coord_type y) const;
+   bool inside(entry const& e, point_type const& pt) const {
+      return e.min.x <= pt.x && pt.x <= e.max.x && e.min.y <= pt.y && pt.y <= e.max.y &&
+            e.dag.query(pt);
+   }
+private:
+   point_type _min, _max;
+   build_options _options;
+   double _cell_w = 1, _cell_h = 1;
+   size_t _columns = 1, _rows = 1;
+   std::vector<entry> _polygons;
+   std::vector<std::vector<region_id> > _cells;   // ascending ids
+};
+
+typedef basic_polygon_atlas<default_kernel> polygon_atlas_type;
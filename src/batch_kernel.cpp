@@ -0,0 +1,179 @@
+#include "batch_kernel.h"
+
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KIRKPATRICK_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define KIRKPATRICK_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KIRKPATRICK_TARGET(isa)
+#endif
+
+namespace {
+
+inline uint32_t lowest_bit(unsigned mask) {
+#if defined(_MSC_VER)
+   unsigned long i;
+   _BitScanForward(&i, mask);
+   return i;
+#else
+   return __builtin_ctz(mask);
+#endif
+}
+
+template<class Kernel>
+size_t contains_scalar(triangle_soa<typename Kernel::coord_type> const& b, uint32_t begin,
+      uint32_t end, typename Kernel::point_type const& pt, uint32_t& hit) {
+   typedef typename Kernel::point_type point_type;
+   size_t count = 0;
+   for(uint32_t i = begin; i != end; ++i) {
+      if(!b.in_box(i, pt.x, pt.y)) continue;
+      int tests = 0;
+      int const where = triangle_position(point_type(b.x1[i], b.y1[i]),
+            point_type(b.x2[i], b.y2[i]), point_type(b.x3[i], b.y3[i]), pt, tests);
+      if(where == 0) continue;
+      if(count++ == 0) hit = i;
+      else break;
+      // Strictly inside one child, the point is in no other.
+      if(where == 2) break;
+   }
+   return count;
+}
+
+#ifdef KIRKPATRICK_X86
+
+// The lanes compute the determinant in wrapping 32-bit arithmetic. That is
+// exact as long as the true value fits in 32 bits, see narrow_extent.
+
+KIRKPATRICK_TARGET("sse4.1")
+inline __m128i determinant_sse41(__m128i ax, __m128i ay, __m128i bx, __m128i by,
+      __m128i cx, __m128i cy) {
+   __m128i d1 = _mm_sub_epi32(_mm_mullo_epi32(bx, cy), _mm_mullo_epi32(cx, by));
+   __m128i d2 = _mm_sub_epi32(_mm_mullo_epi32(ax, cy), _mm_mullo_epi32(cx, ay));
+   __m128i d3 = _mm_sub_epi32(_mm_mullo_epi32(ax, by), _mm_mullo_epi32(bx, ay));
+   return _mm_add_epi32(_mm_sub_epi32(d1, d2), d3);
+}
+
+template<class Point>
+KIRKPATRICK_TARGET("sse4.1")
+size_t contains_sse41(triangle_soa<int32_t> const& b, uint32_t begin, uint32_t end,
+      Point const& pt, uint32_t& hit) {
+   __m128i const px = _mm_set1_epi32(pt.x);
+   __m128i const py = _mm_set1_epi32(pt.y);
+   __m128i const zero = _mm_setzero_si128();
+   size_t count = 0;
+   for(uint32_t i = begin; i < end; i += 4) {
+      __m128i x1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.x1[i]));
+      __m128i y1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.y1[i]));
+      __m128i x2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.x2[i]));
+      __m128i y2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.y2[i]));
+      __m128i x3 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.x3[i]));
+      __m128i y3 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&b.y3[i]));
+      __m128i r = _mm_max_epi32(
+            _mm_max_epi32(determinant_sse41(px, py, x2, y2, x1, y1),
+                          determinant_sse41(px, py, x3, y3, x2, y2)),
+            determinant_sse41(px, py, x1, y1, x3, y3));
+      unsigned mask = ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(r, zero))) & 0xfu;
+      if(end - i < 4) mask &= (1u << (end - i)) - 1;
+      for(; mask; mask &= mask - 1) {
+         if(count++ == 0) hit = i + lowest_bit(mask);
+         else return count;
+      }
+   }
+   return count;
+}
+
+KIRKPATRICK_TARGET("avx2")
+inline __m256i determinant_avx2(__m256i ax, __m256i ay, __m256i bx, __m256i by,
+      __m256i cx, __m256i cy) {
+   __m256i d1 = _mm256_sub_epi32(_mm256_mullo_epi32(bx, cy), _mm256_mullo_epi32(cx, by));
+   __m256i d2 = _mm256_sub_epi32(_mm256_mullo_epi32(ax, cy), _mm256_mullo_epi32(cx, ay));
+   __m256i d3 = _mm256_sub_epi32(_mm256_mullo_epi32(ax, by), _mm256_mullo_epi32(bx, ay));
+   return _mm256_add_epi32(_mm256_sub_epi32(d1, d2), d3);
+}
+
+template<class Point>
+KIRKPATRICK_TARGET("avx2")
+size_t contains_avx2(triangle_soa<int32_t> const& b, uint32_t begin, uint32_t end,
+      Point const& pt, uint32_t& hit) {
+   __m256i const px = _mm256_set1_epi32(pt.x);
+   __m256i const py = _mm256_set1_epi32(pt.y);
+   __m256i const zero = _mm256_setzero_si256();
+   size_t count = 0;
+   for(uint32_t i = begin; i < end; i += 8) {
+      __m256i x1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.x1[i]));
+      __m256i y1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.y1[i]));
+      __m256i x2 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.x2[i]));
+      __m256i y2 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.y2[i]));
+      __m256i x3 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.x3[i]));
+      __m256i y3 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&b.y3[i]));
+      __m256i r = _mm256_max_epi32(
+            _mm256_max_epi32(determinant_avx2(px, py, x2, y2, x1, y1),
+                             determinant_avx2(px, py, x3, y3, x2, y2)),
+            determinant_avx2(px, py, x1, y1, x3, y3));
+      unsigned mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(r, zero))) & 0xffu;
+      if(end - i < 8) mask &= (1u << (end - i)) - 1;
+      for(; mask; mask &= mask - 1) {
+         if(count++ == 0) hit = i + lowest_bit(mask);
+         else return count;
+      }
+   }
+   return count;
+}
+
+#endif
+
+} // namespace
+
+simd_level detect_simd_level() {
+#if defined(KIRKPATRICK_X86) && defined(__GNUC__)
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx2")) return simd_level::avx2;
+   if(__builtin_cpu_supports("sse4.1")) return simd_level::sse41;
+#elif defined(KIRKPATRICK_X86) && defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 1);
+   bool sse41 = (info[2] & (1 << 19)) != 0;
+   bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+   __cpuidex(info, 7, 0);
+   if(os_avx && (info[1] & (1 << 5))) return simd_level::avx2;
+   if(sse41) return simd_level::sse41;
+#endif
+   return simd_level::scalar;
+}
+
+template<class Kernel>
+containment_kernel<Kernel> select_containment_kernel(simd_level level) {
+#ifdef KIRKPATRICK_X86
+   typedef typename Kernel::point_type point_type;
+   if constexpr(std::is_same<typename Kernel::coord_type, int32_t>::value) {
+      switch(level) {
+      case simd_level::avx2: return &contains_avx2<point_type>;
+      case simd_level::sse41: return &contains_sse41<point_type>;
+      case simd_level::scalar: break;
+      }
+   }
+#endif
+   (void)level;
+   return &contains_scalar<Kernel>;
+}
+
+#define INSTANTIATE(K) \
+   template containment_kernel<K> select_containment_kernel<K>(simd_level);
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
+
+char const* to_string(simd_level level) {
+   switch(level) {
+   case simd_level::avx2: return "avx2";
+   case simd_level::sse41: return "sse4.1";
+   case simd_level::scalar: break;
+   }
+   return "scalar";
+}
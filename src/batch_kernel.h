@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "util.h"
+
+// Child triangles of the flat DAG stored as structure-of-arrays, in the same
+// order as the CSR child list, so the children of one node can be tested
+// against a point a few lanes at a time. Their bounding boxes let scalar
+// code skip most children without a predicate. The columns belong to the
+// DAG's storage, this is only a view.
+template<class Coord>
+struct triangle_soa {
+   // Vector kernels read whole lanes past the end of a child range, every
+   // column holds this many zeroes after the last triangle.
+   static const size_t padding = 8;
+
+   Coord const* x1 = nullptr;
+   Coord const* y1 = nullptr;
+   Coord const* x2 = nullptr;
+   Coord const* y2 = nullptr;
+   Coord const* x3 = nullptr;
+   Coord const* y3 = nullptr;
+   Coord const* min_x = nullptr;
+   Coord const* min_y = nullptr;
+   Coord const* max_x = nullptr;
+   Coord const* max_y = nullptr;
+
+   bool in_box(uint32_t i, Coord x, Coord y) const {
+      return min_x[i] <= x && x <= max_x[i] && min_y[i] <= y && y <= max_y[i];
+   }
+};
+
+// Counts the triangles in [begin, end) of the block containing pt (closed,
+// like inside_triangle), stopping at two. The first one found goes to hit.
+// Vector kernels exist for int32 coordinates only. They are only exact if
+// the triangles and pt fit in a box of narrow_extent units per side, the
+// scalar one is as exact as the kernel's predicates.
+template<class Kernel>
+using containment_kernel = size_t (*)(triangle_soa<typename Kernel::coord_type> const& block,
+      uint32_t begin, uint32_t end, typename Kernel::point_type const& pt, uint32_t& hit);
+
+// Twice the area of a triangle in such a box is below 2^31.
+const int64_t narrow_extent = 32767;
+
+enum class simd_level { scalar, sse41, avx2 };
+
+// Best kernel supported by the running CPU.
+simd_level detect_simd_level();
+// Falls back to the scalar kernel where the level has no version for Kernel.
+template<class Kernel>
+containment_kernel<Kernel> select_containment_kernel(simd_level);
+char const* to_string(simd_level);
@@ -0,0 +1,167 @@
+#include "editable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "trace.h"
+
+namespace {
+
+// 1 strictly inside the triangle, 0 outside, -1 on its boundary. The
+// triangle may have any orientation or no area at all.
+template<class Point>
+int triangle_side(Point const& p1, Point const& p2, Point const& p3, Point const& pt) {
+   int area = orientation(p1, p2, p3);
+   int r1 = orientation(p1, p2, pt);
+   int r2 = orientation(p2, p3, pt);
+   int r3 = orientation(p3, p1, pt);
+   if(area == 0) {
+      // Only its edges, pt is in the bounding box already.
+      return r1 == 0 && r2 == 0 && r3 == 0 ? -1 : 0;
+   }
+   if(r1 == -area || r2 == -area || r3 == -area) return 0;
+   return r1 == 0 || r2 == 0 || r3 == 0 ? -1 : 1;
+}
+
+// Closed point in polygon test, linear in the number of vertices.
+template<class Point>
+bool inside_ring(std::vector<Point> const& ring, Point const& pt) {
+   bool res = false;
+   for(size_t i = 0, j = ring.size() - 1; i != ring.size(); j = i++) {
+      Point const& a = ring[j];
+      Point const& b = ring[i];
+      int o = orientation(a, b, pt);
+      if(o == 0 && std::min(a.x, b.x) <= pt.x && pt.x <= std::max(a.x, b.x) &&
+            std::min(a.y, b.y) <= pt.y && pt.y <= std::max(a.y, b.y))
+         return true;
+      if((a.y > pt.y) != (b.y > pt.y) && (b.y > a.y ? o > 0 : o < 0))
+         res = !res;
+   }
+   return res;
+}
+
+} // namespace
+
+template<class Kernel>
+basic_editable_kirkpatrick<Kernel>::basic_editable_kirkpatrick(point_arr const& points,
+      build_options const& options, size_t max_patches):
+   _points(points), _options(options), _max_patches(max_patches),
+   _base(std::make_shared<kirkpatrick_type const>(points, options)) { }
+
+template<class Kernel>
+size_t basic_editable_kirkpatrick<Kernel>::check_index(size_t i, size_t limit) const {
+   if(i >= limit)
+      throw std::out_of_range("polygon vertex index out of range");
+   return i;
+}
+
+// Boundaries add up under even-odd: replacing the edges a -> v -> b by
+// a -> b, or the other way round, flips exactly the points inside a, v, b.
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::add_patch(point_type const& p1, point_type const& p2,
+      point_type const& p3) {
+   patch p = { p1, p2, p3, p1, p1, _edits };
+   for(auto const& q: { p2, p3 }) {
+      p.min = point_type(std::min(p.min.x, q.x), std::min(p.min.y, q.y));
+      p.max = point_type(std::max(p.max.x, q.x), std::max(p.max.y, q.y));
+   }
+   _patches.push_back(p);
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::insert(size_t i, point_type const& pt) {
+   check_index(i, _points.size() + 1);
+   size_t const n = _points.size();
+   add_patch(_points[(i + n - 1) % n], pt, _points[i % n]);
+   _points.insert(_points.begin() + i, pt);
+   edited();
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::move(size_t i, point_type const& pt) {
+   check_index(i, _points.size());
+   size_t const n = _points.size();
+   point_type const& prev = _points[(i + n - 1) % n];
+   point_type const& next = _points[(i + 1) % n];
+   add_patch(prev, _points[i], next);
+   add_patch(prev, pt, next);
+   _points[i] = pt;
+   edited();
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::erase(size_t i) {
+   check_index(i, _points.size());
+   if(_points.size() == 3)
+      throw std::logic_error("a polygon keeps at least three vertices");
+   size_t const n = _points.size();
+   add_patch(_points[(i + n - 1) % n], _points[i], _points[(i + 1) % n]);
+   _points.erase(_points.begin() + i);
+   edited();
+}
+
+template<class Kernel>
+bool basic_editable_kirkpatrick<Kernel>::rebuilt() const {
+   return _rebuild.valid() &&
+         _rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::edited() {
+   ++_edits;
+   if(rebuilt()) adopt();
+   if(_patches.size() <= _max_patches) return;
+   rebalance();
+   if(_patches.size() <= 4 * _max_patches) return;
+   wait();
+   if(_patches.size() <= 4 * _max_patches) return;
+   KIRKPATRICK_TRACE(info, build) << "rebuilding in place after" << _patches.size() << "patches";
+   _base = std::make_shared<kirkpatrick_type const>(_points, _options);
+   _patches.clear();
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::rebalance() {
+   if(_rebuild.valid()) return;
+   _rebuild_edits = _edits;
+   KIRKPATRICK_TRACE(info, build) << "rebuilding after" << _patches.size() << "patches";
+   _rebuild = std::async(std::launch::async, [](point_arr points, build_options options) {
+      return std::make_shared<kirkpatrick_type const>(points, options);
+   }, _points, _options);
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::wait() {
+   if(_rebuild.valid()) adopt();
+}
+
+template<class Kernel>
+void basic_editable_kirkpatrick<Kernel>::adopt() const {
+   _base = _rebuild.get();
+   uint64_t const included = _rebuild_edits;
+   _patches.erase(std::remove_if(_patches.begin(), _patches.end(),
+            [included](patch const& p) { return p.edit < included; }), _patches.end());
+   KIRKPATRICK_TRACE(info, build) << "rebuild adopted," << _patches.size() << "patches left";
+}
+
+// Points on a patch edge may be on the new boundary or on a removed one,
+// they are rare and get the exact linear test.
+template<class Kernel>
+bool basic_editable_kirkpatrick<Kernel>::query(point_type const& pt) const {
+   if(rebuilt()) adopt();
+   bool flip = false;
+   for(auto const& p: _patches) {
+      if(pt.x < p.min.x || pt.x > p.max.x || pt.y < p.min.y || pt.y > p.max.y) continue;
+      int side = triangle_side(p.p1, p.p2, p.p3, pt);
+      if(side < 0) return inside_ring(_points, pt);
+      if(side > 0) flip = !flip;
+   }
+   if(!flip) return _base->query(pt);
+   // Strictly inside the old polygon flips to outside, but an old edge
+   // inside a patch is still an edge.
+   return !_base->query(pt) || _base->dag().on_boundary(pt);
+}
+
+#define INSTANTIATE(K) template struct basic_editable_kirkpatrick<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
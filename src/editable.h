@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "kirkpatrick.h"
+
+// A simple polygon whose vertices may be inserted, moved and erased after
+// the hierarchy is built. An edit does not touch the hierarchy: it records
+// the triangles between the old and the new boundary, where the answer
+// flips, and queries combine the two. Once there are more than
+// max_patches of them the hierarchy is rebuilt from the current polygon on
+// a background thread; edits and queries go on meanwhile and the first of
+// them to see the rebuild done takes it over. The patches never exceed
+// 4 * max_patches: an edit past that waits for the running rebuild, and
+// rebuilds in place if the patches made meanwhile are still too many.
+// Edits must keep the polygon simple, this is not checked. Not thread
+// safe, and since queries may take over a rebuild not even concurrent
+// queries are.
+template<class Kernel>
+struct basic_editable_kirkpatrick {
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   typedef basic_kirkpatrick<Kernel> kirkpatrick_type;
+
+   explicit basic_editable_kirkpatrick(point_arr const&,
+         build_options const& = build_options(), size_t max_patches = 64);
+   point_arr const& points() const { return _points; }
+   size_t size() const { return _points.size(); }
+   // Inserts pt between vertices i - 1 and i, i == size() appends.
+   void insert(size_t i, point_type const& pt);
+   void move(size_t i, point_type const& pt);
+   void erase(size_t i);
+   // Same answer as a kirkpatrick_type built from points(). Linear in the
+   // number of vertices for points on the edge of a patch.
+   bool query(point_type const&) const;
+   // Patches not yet folded into the hierarchy.
+   size_t patches() const { return _patches.size(); }
+   // Starts a background rebuild unless one is running.
+   void rebalance();
+   // Waits for a running rebuild and takes it over. Rethrows its errors.
+   void wait();
+private:
+   struct patch {
+      point_type p1, p2, p3;
+      point_type min, max;          // bounding box
+      uint64_t edit;
+   };
+   void add_patch(point_type const& p1, point_type const& p2, point_type const& p3);
+   void edited();
+   void adopt() const;
+   bool rebuilt() const;
+   size_t check_index(size_t i, size_t limit) const;
+private:
+   point_arr _points;
+   build_options _options;
+   size_t _max_patches;
+   // Queries take over a finished rebuild too.
+   mutable std::shared_ptr<kirkpatrick_type const> _base;
+   mutable std::vector<patch> _patches;
+   uint64_t _edits = 0;
+   mutable std::future<std::shared_ptr<kirkpatrick_type const> > _rebuild;
+   uint64_t _rebuild_edits = 0;            // edits the running rebuild includes
+};
+
+typedef basic_editable_kirkpatrick<default_kernel> editable_kirkpatrick_type;
@@ -0,0 +1,631 @@
+#include "flat_dag.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/container/small_vector.hpp>
+
+#include "mapped_file.h"
+
+namespace {
+
+char const dag_magic[8] = { 'K', 'I', 'R', 'K', 'D', 'A', 'G', 0 };
+uint32_t const native_byte_order = 0x01020304;
+
+size_t const cache_line = 64;
+
+// Byte offsets of the arrays in the image. Every array starts on a cache
+// line, since images start on one too: built ones are allocated aligned,
+// mapped ones start on a page.
+struct dag_layout {
+   size_t vertices, triangles, child_offsets, child_indices, regions;
+   size_t soa[10];
+   size_t size;
+};
+
+size_t align_up(size_t n) { return (n + cache_line - 1) / cache_line * cache_line; }
+
+// Zero filled image of the given size, aligned to a cache line.
+std::shared_ptr<char> allocate_image(size_t bytes) {
+   std::align_val_t const align{ cache_line };
+   std::shared_ptr<char> res(static_cast<char*>(::operator new(bytes, align)),
+         [align](char* p) { ::operator delete(p, align); });
+   std::memset(res.get(), 0, bytes);
+   return res;
+}
+
+template<class Coord>
+uint32_t coordinates_of();
+template<> uint32_t coordinates_of<int32_t>() { return flat_dag_header::int32_coordinates; }
+template<> uint32_t coordinates_of<int64_t>() { return flat_dag_header::int64_coordinates; }
+template<> uint32_t coordinates_of<float>() { return flat_dag_header::float_coordinates; }
+template<> uint32_t coordinates_of<double>() { return flat_dag_header::double_coordinates; }
+
+template<class Coord>
+dag_layout layout_of(flat_dag_header const& h) {
+   typedef uint32_t index_type;
+   dag_layout l;
+   size_t pos = align_up(sizeof(flat_dag_header));
+   auto take = [&pos](size_t bytes) { size_t res = pos; pos = align_up(pos + bytes); return res; };
+   l.vertices = take(size_t(h.vertex_count) * 2 * sizeof(Coord));
+   l.triangles = take(size_t(h.triangle_count) * 3 * sizeof(index_type));
+   l.child_offsets = take((size_t(h.triangle_count) + 1) * sizeof(index_type));
+   l.child_indices = take(size_t(h.child_count) * sizeof(index_type));
+   l.regions = take(size_t(h.triangle_count) * sizeof(region_id));
+   for(auto& column: l.soa)
+      column = take((size_t(h.child_count) + h.padding) * sizeof(Coord));
+   l.size = pos;
+   return l;
+}
+
+template<class T>
+void copy_to(char* image, size_t offset, std::vector<T> const& v) {
+   if(!v.empty()) std::memcpy(image + offset, v.data(), v.size() * sizeof(T));
+}
+
+// Nodes reachable from top in discovery order of a depth-first walk. A
+// node may be a child of several parents, it is numbered the first time
+// it is reached, and all children of a node are numbered together.
+template<class Triangle>
+std::vector<Triangle const*> depth_first_order(Triangle const* top) {
+   std::unordered_set<Triangle const*> seen { top };
+   std::vector<Triangle const*> order(1, top);
+   std::vector<Triangle const*> stack(1, top);
+   while(!stack.empty()) {
+      Triangle const* t = stack.back();
+      stack.pop_back();
+      for(auto const& c: t->children()) {
+         if(seen.insert(c.get()).second) {
+            order.push_back(c.get());
+            stack.push_back(c.get());
+         }
+      }
+   }
+   return order;
+}
+
+// The same, breadth-first. The children a node reaches first follow each
+// other, they are first_child[i] .. first_child[i + 1] of order[i], and
+// depth[i] is the length of the shortest path from top.
+template<class Triangle>
+std::vector<Triangle const*> breadth_first_order(Triangle const* top,
+      std::vector<uint32_t>* first_child = nullptr, std::vector<uint32_t>* depth = nullptr) {
+   std::unordered_set<Triangle const*> seen { top };
+   std::vector<Triangle const*> order(1, top);
+   if(depth) depth->assign(1, 0);
+   for(size_t i = 0; i != order.size(); ++i) {
+      if(first_child) first_child->push_back(uint32_t(order.size()));
+      for(auto const& c: order[i]->children()) {
+         if(seen.insert(c.get()).second) {
+            order.push_back(c.get());
+            if(depth) depth->push_back((*depth)[i] + 1);
+         }
+      }
+   }
+   if(first_child) first_child->push_back(uint32_t(order.size()));
+   return order;
+}
+
+// Van Emde Boas order of the breadth-first tree below position root, as
+// far as height levels: the upper half of the levels, then every subtree
+// hanging off it, each laid out the same way. A descent through h levels
+// touches O(h / log B) blocks of B nodes for any B.
+void van_emde_boas(uint32_t root, uint32_t height, std::vector<uint32_t> const& first_child,
+      std::vector<uint32_t>& out) {
+   if(height == 1) {
+      out.push_back(root);
+      return;
+   }
+   uint32_t const top = height / 2;
+   van_emde_boas(root, top, first_child, out);
+   std::vector<uint32_t> fringe(1, root), next;
+   for(uint32_t level = 0; level != top && !fringe.empty(); ++level) {
+      next.clear();
+      for(auto v: fringe) {
+         for(uint32_t c = first_child[v]; c != first_child[v + 1]; ++c) next.push_back(c);
+      }
+      fringe.swap(next);
+   }
+   for(auto v: fringe) van_emde_boas(v, height - top, first_child, out);
+}
+
+template<class Triangle>
+std::vector<Triangle const*> node_order(Triangle const* top, node_layout layout) {
+   switch(layout) {
+   case node_layout::depth_first: return depth_first_order(top);
+   case node_layout::breadth_first: return breadth_first_order(top);
+   case node_layout::van_emde_boas: break;
+   }
+   std::vector<uint32_t> first_child, depth, positions;
+   auto const bfs = breadth_first_order(top, &first_child, &depth);
+   positions.reserve(bfs.size());
+   van_emde_boas(0, depth.back() + 1, first_child, positions);
+   std::vector<Triangle const*> order;
+   order.reserve(bfs.size());
+   for(auto i: positions) order.push_back(bfs[i]);
+   return order;
+}
+
+} // namespace
+
+char const* to_string(node_layout layout) {
+   switch(layout) {
+   case node_layout::depth_first: return "depth_first";
+   case node_layout::breadth_first: return "breadth_first";
+   case node_layout::van_emde_boas: return "van_emde_boas";
+   }
+   return "?";
+}
+
+template<class Kernel>
+basic_flat_dag<Kernel>::basic_flat_dag(triangle_ptr const& top, node_layout layout) {
+   static_assert(sizeof(point_type) == 2 * sizeof(coord_type),
+         "flat DAG images store points as two coordinates");
+   static_assert(std::is_trivially_copyable<point_type>::value,
+         "flat DAG images store points as two coordinates");
+   typedef basic_triangle<Kernel> triangle_type;
+   if(!top) return;
+   std::vector<triangle_type const*> const order = node_order(top.get(), layout);
+   std::unordered_map<triangle_type const*, index_type> ids(order.size());
+   for(size_t i = 0; i != order.size(); ++i) ids[order[i]] = index_type(i);
+
+   typename Kernel::point_arr vertices;
+   std::map<point_type, index_type> vertex_ids;
+   auto vertex = [&](point_type const& p) {
+      auto it = vertex_ids.emplace(p, index_type(vertices.size()));
+      if(it.second) vertices.push_back(p);
+      return it.first->second;
+   };
+
+   std::vector<triangle_indices> triangles;
+   std::vector<index_type> child_offsets, child_indices;
+   std::vector<region_id> regions;
+   std::vector<coord_type> soa[10];        // corners, then bounding boxes
+   triangles.reserve(order.size());
+   regions.reserve(order.size());
+   child_offsets.reserve(order.size() + 1);
+   child_offsets.push_back(0);
+   for(auto t: order) {
+      triangles.push_back({{ vertex(t->p1()), vertex(t->p2()), vertex(t->p3()) }});
+      regions.push_back(t->children().empty() ? t->region() : no_region);
+      for(auto const& c: t->children()) {
+         child_indices.push_back(ids[c.get()]);
+         coord_type const coords[10] = { c->p1().x, c->p1().y, c->p2().x, c->p2().y,
+               c->p3().x, c->p3().y,
+               std::min({ c->p1().x, c->p2().x, c->p3().x }),
+               std::min({ c->p1().y, c->p2().y, c->p3().y }),
+               std::max({ c->p1().x, c->p2().x, c->p3().x }),
+               std::max({ c->p1().y, c->p2().y, c->p3().y }) };
+         for(size_t k = 0; k != 10; ++k) soa[k].push_back(coords[k]);
+      }
+      child_offsets.push_back(index_type(child_indices.size()));
+   }
+
+   flat_dag_header h;
+   std::memcpy(h.magic, dag_magic, sizeof(h.magic));
+   h.version = flat_dag_header::current_version;
+   h.byte_order = native_byte_order;
+   h.padding = triangle_soa<coord_type>::padding;
+   h.vertex_count = uint32_t(vertices.size());
+   h.triangle_count = uint32_t(triangles.size());
+   h.child_count = uint32_t(child_indices.size());
+   h.coordinates = coordinates_of<coord_type>();
+   h.layout = uint32_t(layout);
+   dag_layout const l = layout_of<coord_type>(h);
+   h.size = l.size;
+   // Zero filled, which also takes care of the padding after the columns.
+   std::shared_ptr<char> buffer = allocate_image(l.size);
+   char* image = buffer.get();
+   std::memcpy(image, &h, sizeof(h));
+   copy_to(image, l.vertices, vertices);
+   copy_to(image, l.triangles, triangles);
+   copy_to(image, l.child_offsets, child_offsets);
+   copy_to(image, l.child_indices, child_indices);
+   copy_to(image, l.regions, regions);
+   for(size_t k = 0; k != 10; ++k) copy_to(image, l.soa[k], soa[k]);
+   attach(buffer, image, l.size);
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::attach(std::shared_ptr<void const> storage, char const* image,
+      size_t bytes) {
+   if(bytes < sizeof(flat_dag_header))
+      throw std::runtime_error("flat DAG image is truncated");
+   flat_dag_header h;
+   std::memcpy(&h, image, sizeof(h));
+   if(std::memcmp(h.magic, dag_magic, sizeof(h.magic)) != 0)
+      throw std::runtime_error("not a flat DAG image");
+   if(h.byte_order != native_byte_order)
+      throw std::runtime_error("flat DAG image has a foreign byte order");
+   if(h.version != flat_dag_header::current_version)
+      throw std::runtime_error("unsupported flat DAG image version");
+   if(h.padding != triangle_soa<coord_type>::padding)
+      throw std::runtime_error("flat DAG image has a different kernel padding");
+   if(h.coordinates != coordinates_of<coord_type>())
+      throw std::runtime_error("flat DAG image has another coordinate type");
+   dag_layout const l = layout_of<coord_type>(h);
+   if(h.size != l.size || bytes < l.size)
+      throw std::runtime_error("flat DAG image is truncated");
+   // Only the header and the sizes it implies are checked here, and the
+   // end of the child list. load() verifies the contents with check(),
+   // built images are right by construction.
+   _child_offsets = reinterpret_cast<index_type const*>(image + l.child_offsets);
+   if(_child_offsets[h.triangle_count] != h.child_count)
+      throw std::runtime_error("flat DAG image is inconsistent");
+
+   _storage = std::move(storage);
+   _image = image;
+   _size = h.triangle_count;
+   _vertices = reinterpret_cast<point_type const*>(image + l.vertices);
+   _triangles = reinterpret_cast<triangle_indices const*>(image + l.triangles);
+   _child_indices = reinterpret_cast<index_type const*>(image + l.child_indices);
+   _regions = reinterpret_cast<region_id const*>(image + l.regions);
+   // Every vertex lies in the top triangle and queries outside of it never
+   // reach a kernel, so its bounding box bounds all the determinants.
+   if(std::is_same<coord_type, int32_t>::value && _size != 0) {
+      triangle_indices const& top = _triangles[0];
+      int64_t min_x = int64_t(_vertices[top[0]].x), max_x = min_x;
+      int64_t min_y = int64_t(_vertices[top[0]].y), max_y = min_y;
+      for(auto v: top) {
+         min_x = std::min(min_x, int64_t(_vertices[v].x));
+         max_x = std::max(max_x, int64_t(_vertices[v].x));
+         min_y = std::min(min_y, int64_t(_vertices[v].y));
+         max_y = std::max(max_y, int64_t(_vertices[v].y));
+      }
+      _narrow = max_x - min_x <= narrow_extent && max_y - min_y <= narrow_extent;
+   }
+   coord_type const** columns[10] = { &_child_triangles.x1, &_child_triangles.y1,
+      &_child_triangles.x2, &_child_triangles.y2, &_child_triangles.x3, &_child_triangles.y3,
+      &_child_triangles.min_x, &_child_triangles.min_y, &_child_triangles.max_x,
+      &_child_triangles.max_y };
+   for(size_t k = 0; k != 10; ++k)
+      *columns[k] = reinterpret_cast<coord_type const*>(image + l.soa[k]);
+}
+
+template<class Kernel>
+size_t basic_flat_dag<Kernel>::bytes() const {
+   if(!_image) return 0;
+   flat_dag_header h;
+   std::memcpy(&h, _image, sizeof(h));
+   return size_t(h.size);
+}
+
+template<class Kernel>
+node_layout basic_flat_dag<Kernel>::layout() const {
+   if(!_image) return node_layout::depth_first;
+   flat_dag_header h;
+   std::memcpy(&h, _image, sizeof(h));
+   return node_layout(h.layout);
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::save(std::string const& path) const {
+   if(!_image)
+      throw std::runtime_error("flat DAG has no image to save");
+   // Never in place: loaded DAGs may still map the old file.
+   replace_file(path, _image, bytes());
+}
+
+template<class Kernel>
+basic_flat_dag<Kernel> basic_flat_dag<Kernel>::load(std::string const& path) {
+   auto file = std::make_shared<mapped_file>(path);
+   basic_flat_dag res;
+   char const* image = file->data();
+   size_t const bytes = file->size();
+   res.attach(std::move(file), image, bytes);
+   res.check();
+   return res;
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::check() const {
+   flat_dag_header h;
+   std::memcpy(&h, _image, sizeof(h));
+   auto fail = [] { throw std::runtime_error("flat DAG image is inconsistent"); };
+   if(_size == 0) {
+      if(h.child_count != 0) fail();
+      return;
+   }
+   for(size_t t = 0; t != _size; ++t) {
+      for(auto v: _triangles[t]) if(v >= h.vertex_count) fail();
+   }
+   // In-degrees for the cycle check below.
+   std::vector<index_type> parents(_size, 0);
+   if(_child_offsets[0] != 0) fail();
+   for(index_type t = 0; t != _size; ++t) {
+      index_type const first = _child_offsets[t], last = _child_offsets[t + 1];
+      if(last < first || last > h.child_count) fail();
+      if(_regions[t] < no_region || (first != last && _regions[t] != no_region)) fail();
+      for(index_type c = first; c != last; ++c) {
+         index_type const child = _child_indices[c];
+         if(child == 0 || child >= _size) fail();
+         ++parents[child];
+         triangle_indices const& tr = _triangles[child];
+         triangle_soa<coord_type> const& s = _child_triangles;
+         point_type const& p1 = _vertices[tr[0]];
+         point_type const& p2 = _vertices[tr[1]];
+         point_type const& p3 = _vertices[tr[2]];
+         if(s.x1[c] != p1.x || s.y1[c] != p1.y || s.x2[c] != p2.x || s.y2[c] != p2.y ||
+               s.x3[c] != p3.x || s.y3[c] != p3.y ||
+               s.min_x[c] != std::min({ p1.x, p2.x, p3.x }) ||
+               s.min_y[c] != std::min({ p1.y, p2.y, p3.y }) ||
+               s.max_x[c] != std::max({ p1.x, p2.x, p3.x }) ||
+               s.max_y[c] != std::max({ p1.y, p2.y, p3.y }))
+            fail();
+      }
+   }
+   // Takes away the nodes whose parents are all gone, starting at the top.
+   // Nodes on a cycle are never taken.
+   std::vector<index_type> ready(1, 0);
+   size_t taken = 0;
+   while(!ready.empty()) {
+      index_type const t = ready.back();
+      ready.pop_back();
+      ++taken;
+      for(index_type c = _child_offsets[t]; c != _child_offsets[t + 1]; ++c) {
+         if(--parents[_child_indices[c]] == 0) ready.push_back(_child_indices[c]);
+      }
+   }
+   if(taken != _size) fail();
+}
+
+// Same answer as basic_triangle::locate: the region of the first leaf, in
+// child order, reachable through triangles containing the point. Points on
+// shared edges may descend into several children, hence the explicit stack.
+// Children are interior-disjoint, so one that holds the point strictly is
+// the only one and ends the scan. Those whose box misses the point cost no
+// predicate at all.
+template<class Kernel>
+template<bool Instrumented>
+region_id basic_flat_dag<Kernel>::descend(point_type const& pt, query_stats* stats) const {
+   query_probe<Instrumented> probe(stats);
+   if(empty())
+      return no_region;
+   probe.tested();
+   int tests = 0;
+   triangle_indices const& top = _triangles[0];
+   int const top_position = triangle_position(_vertices[top[0]], _vertices[top[1]],
+         _vertices[top[2]], pt, tests);
+   probe.oriented(tests);
+   if(top_position == 0)
+      return no_region;
+   boost::container::small_vector<index_type, 64> stack(1, 0);
+   while(!stack.empty()) {
+      index_type t = stack.back();
+      stack.pop_back();
+      probe.pop();
+      index_type begin = _child_offsets[t], end = _child_offsets[t + 1];
+      if(begin == end) {
+         probe.leaf();
+         if(_regions[t] != no_region) return _regions[t];
+         continue;
+      }
+      size_t const stacked = stack.size();
+      for(index_type c = begin; c != end; ++c) {
+         if(!_child_triangles.in_box(c, pt.x, pt.y)) continue;
+         probe.tested();
+         tests = 0;
+         int const where = child_position(c, pt, tests);
+         probe.oriented(tests);
+         if(where == 0) continue;
+         stack.push_back(_child_indices[c]);
+         probe.push();
+         if(where == 2) break;
+      }
+      // The first child containing the point goes on top.
+      std::reverse(stack.begin() + stacked, stack.end());
+      if(stack.size() > stacked + 1) probe.branched();
+   }
+   return no_region;
+}
+
+template<class Kernel>
+region_id basic_flat_dag<Kernel>::locate(point_type const& pt) const {
+   return descend<false>(pt, nullptr);
+}
+
+template<class Kernel>
+region_id basic_flat_dag<Kernel>::locate(point_type const& pt, query_stats& stats) const {
+   return descend<true>(pt, &stats);
+}
+
+// Leaves tile the top triangle, so a leaf holding pt strictly is the only
+// leaf holding it and gives the answer of any descent. Which path led to
+// it does not matter, nor whether the cursor last served another DAG;
+// only the indices have to be in range.
+template<class Kernel>
+region_id basic_flat_dag<Kernel>::locate(point_type const& pt, query_cursor& cursor) const {
+   auto& path = cursor._path;
+   int where = 0, tests = 0;
+   // Up one, two, four... levels, a far jump gets back to the top soon.
+   size_t kept = path.size();
+   for(size_t up = 1; kept != 0; up *= 2) {
+      index_type const t = path[kept - 1];
+      if(t < _size && (where = position(t, pt, tests)) != 0) break;
+      kept = kept > up ? kept - up : 0;
+   }
+   path.resize(kept);
+   if(path.empty()) {
+      if(empty() || (where = position(0, pt, tests)) == 0) {
+         ++cursor.walked;
+         return no_region;
+      }
+      path.push_back(0);
+   }
+   // Children cover their parent, some child holds pt. The first one
+   // holding it strictly is taken, else the first one holding it at all.
+   for(;;) {
+      index_type t = path.back();
+      index_type begin = _child_offsets[t], end = _child_offsets[t + 1];
+      if(begin == end) break;
+      index_type next = begin;
+      int next_where = 0;
+      for(index_type c = begin; c != end; ++c) {
+         if(!_child_triangles.in_box(c, pt.x, pt.y)) continue;
+         int const w = child_position(c, pt, tests);
+         if(w == 0 || w <= next_where) continue;
+         next = c;
+         next_where = w;
+         if(w == 2) break;
+      }
+      if(next_where == 0) break;
+      path.push_back(_child_indices[next]);
+      where = next_where;
+   }
+   index_type const leaf = path.back();
+   if(where == 2 && _child_offsets[leaf] == _child_offsets[leaf + 1]) {
+      ++cursor.walked;
+      return _regions[leaf];
+   }
+   ++cursor.descended;
+   return locate(pt);
+}
+
+template<class Kernel>
+dag_shape basic_flat_dag<Kernel>::shape() const {
+   dag_shape res;
+   res.triangles = _size;
+   if(empty()) return res;
+   // Children may have smaller indices than some of their parents, the
+   // depths are settled in post order.
+   std::vector<uint32_t> height(_size, 0);
+   std::vector<uint8_t> done(_size, 0);
+   std::vector<index_type> stack(1, 0);
+   while(!stack.empty()) {
+      index_type t = stack.back();
+      index_type begin = _child_offsets[t], end = _child_offsets[t + 1];
+      if(done[t]) {
+         stack.pop_back();
+         continue;
+      }
+      bool ready = true;
+      for(index_type c = begin; c != end; ++c) {
+         if(!done[_child_indices[c]]) {
+            stack.push_back(_child_indices[c]);
+            ready = false;
+         }
+      }
+      if(!ready) continue;
+      stack.pop_back();
+      done[t] = 1;
+      for(index_type c = begin; c != end; ++c)
+         height[t] = std::max(height[t], height[_child_indices[c]] + 1);
+      if(begin == end) {
+         ++res.leaves;
+      } else {
+         if(res.fan_out.size() <= end - begin) res.fan_out.resize(end - begin + 1);
+         ++res.fan_out[end - begin];
+      }
+   }
+   res.depth = height[0];
+   return res;
+}
+
+// The same descent as locate, through all the leaves containing pt.
+template<class Kernel>
+bool basic_flat_dag<Kernel>::on_boundary(point_type const& pt) const {
+   if(empty() || !inside(0, pt))
+      return false;
+   boost::container::small_vector<index_type, 64> stack(1, 0);
+   bool seen = false;
+   region_id first = no_region;
+   while(!stack.empty()) {
+      index_type t = stack.back();
+      stack.pop_back();
+      index_type begin = _child_offsets[t], end = _child_offsets[t + 1];
+      if(begin == end) {
+         if(seen && _regions[t] != first) return true;
+         seen = true;
+         first = _regions[t];
+         continue;
+      }
+      for(index_type c = begin; c != end; ++c) {
+         if(!_child_triangles.in_box(c, pt.x, pt.y)) continue;
+         int tests = 0;
+         int const where = child_position(c, pt, tests);
+         if(where == 0) continue;
+         stack.push_back(_child_indices[c]);
+         if(where == 2) break;
+      }
+   }
+   return false;
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::query_batch(point_type const* pts, size_t count,
+      uint8_t* out) const {
+   static simd_level const level = detect_simd_level();
+   query_batch(pts, count, out, level);
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::query_batch(point_type const* pts, size_t count, uint8_t* out,
+      simd_level level) const {
+   containment_kernel<Kernel> const contains = kernel_for(level);
+   region_id regions[block_size];
+   for(size_t first = 0; first < count; first += block_size) {
+      size_t const n = std::min(block_size, count - first);
+      locate_block(pts + first, n, regions, contains);
+      for(size_t i = 0; i != n; ++i) out[first + i] = regions[i] != no_region;
+   }
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::locate_batch(point_type const* pts, size_t count,
+      region_id* out) const {
+   static simd_level const level = detect_simd_level();
+   locate_batch(pts, count, out, level);
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::locate_batch(point_type const* pts, size_t count, region_id* out,
+      simd_level level) const {
+   containment_kernel<Kernel> const contains = kernel_for(level);
+   for(size_t first = 0; first < count; first += block_size)
+      locate_block(pts + first, std::min(block_size, count - first), out + first, contains);
+}
+
+template<class Kernel>
+void basic_flat_dag<Kernel>::locate_block(point_type const* pts, size_t count,
+      region_id* out, containment_kernel<Kernel> contains) const {
+   index_type nodes[block_size];
+   uint32_t active[block_size];
+   size_t active_count = 0;
+   for(size_t i = 0; i != count; ++i) {
+      out[i] = no_region;
+      if(empty() || !inside(0, pts[i])) continue;
+      nodes[i] = 0;
+      active[active_count++] = uint32_t(i);
+   }
+   while(active_count != 0) {
+      size_t kept = 0;
+      for(size_t k = 0; k != active_count; ++k) {
+         uint32_t i = active[k];
+         index_type t = nodes[i];
+         index_type begin = _child_offsets[t], end = _child_offsets[t + 1];
+         if(begin == end) {
+            out[i] = _regions[t];
+            continue;
+         }
+         uint32_t hit = 0;
+         size_t hits = contains(_child_triangles, begin, end, pts[i], hit);
+         if(hits == 1) {
+            nodes[i] = _child_indices[hit];
+            active[kept++] = i;
+         } else if(hits > 1) {
+            // The point is on an edge shared by several children.
+            out[i] = locate(pts[i]);
+         }
+      }
+      active_count = kept;
+   }
+}
+
+#define INSTANTIATE(K) template struct basic_flat_dag<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
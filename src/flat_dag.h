@@ -0,0 +1,163 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/container/small_vector.hpp>
+
+#include "batch_kernel.h"
+#include "stats.h"
+#include "triangle.h"
+#include "util.h"
+
+// Order of the nodes in the image. Answers do not depend on it, only which
+// nodes of a descent share cache lines and pages.
+enum class node_layout {
+   depth_first,       // discovery order of a depth-first walk
+   breadth_first,     // level by level, the children a node reaches first side by side
+   van_emde_boas      // recursive halves of the levels, cache-oblivious
+};
+
+char const* to_string(node_layout);
+
+// Header of the binary image of a flat DAG. The same image backs a DAG
+// built in memory and one mapped from a file, see flat_dag_type::save().
+// All counts are native-endian, a file written on a machine with another
+// byte order is rejected.
+struct flat_dag_header {
+   static const uint32_t current_version = 4;
+   enum : uint32_t { int32_coordinates = 1, int64_coordinates, float_coordinates,
+                     double_coordinates };
+
+   char magic[8];                // "KIRKDAG" and a zero
+   uint32_t version;
+   uint32_t byte_order;          // 0x01020304 as written
+   uint32_t padding;             // triangle_soa::padding
+   uint32_t vertex_count;
+   uint32_t triangle_count;
+   uint32_t child_count;
+   uint32_t coordinates;         // type of the kernel, its predicates do not matter
+   uint32_t layout;              // node_layout, for information only
+   uint64_t size;                // of the whole image in bytes
+};
+
+// Where the last query of a stream of nearby points ended, see
+// basic_flat_dag::locate(pt, query_cursor&). One per stream and thread.
+struct query_cursor {
+   size_t walked = 0;            // answered from the last path
+   size_t descended = 0;         // took the full descent from the top
+   void reset() { _path.clear(); }
+private:
+   template<class> friend struct basic_flat_dag;
+   boost::container::small_vector<uint32_t, 64> _path;   // top to the last leaf
+};
+
+// Read-only copy of the triangle hierarchy, laid out in flat arrays.
+// Node 0 is the top triangle, children of node t are
+// _child_indices[_child_offsets[t] .. _child_offsets[t + 1]), their
+// coordinates are stored with the child list. The other nodes are numbered
+// in the given layout, so are the child lists.
+// Nothing is modified after construction and queries do not log, so const
+// member functions may be called concurrently. Queries do not allocate in
+// the common case: the descent stack and a cursor path hold 64 nodes in
+// place and only go to the heap beyond that, for a point on edges shared
+// by many stacked children or for a path deeper than 64 levels.
+// The arrays live in one shared image, copies of a DAG are cheap and share it.
+template<class Kernel>
+struct basic_flat_dag {
+   typedef uint32_t index_type;
+   typedef std::array<index_type, 3> triangle_indices;
+   typedef typename Kernel::coord_type coord_type;
+   typedef typename Kernel::point_type point_type;
+   typedef basic_triangle_ptr<Kernel> triangle_ptr;
+
+   basic_flat_dag() { }
+   explicit basic_flat_dag(triangle_ptr const& top,
+         node_layout layout = node_layout::van_emde_boas);
+   // Writes the image, load() maps it back without copying or rebuilding.
+   // save() replaces a file atomically (see replace_file), DAGs loaded
+   // from it go on with the old image. Both throw std::runtime_error on I/O errors and malformed files. load()
+   // reads the whole image once to check it: indices in range, child lists
+   // that match their coordinates and no cycles, so that no file can make
+   // a query read out of bounds or loop.
+   void save(std::string const& path) const;
+   static basic_flat_dag load(std::string const& path);
+   bool query(point_type const& pt) const { return locate(pt) != no_region; }
+   // Region of the first leaf containing pt, see basic_triangle::locate.
+   region_id locate(point_type const&) const;
+   // The same, and counts the work done into stats.
+   region_id locate(point_type const&, query_stats& stats) const;
+   // locate(pt) for a stream of nearby points. The cursor keeps the path
+   // to the leaf of its last query, climbs it only as far as the first
+   // triangle holding pt and descends from there. A point still inside
+   // that leaf costs one triangle test. Points on an edge of their leaf
+   // get the full descent, so answers are always those of locate(pt).
+   region_id locate(point_type const&, query_cursor&) const;
+   bool query(point_type const& pt, query_cursor& cursor) const {
+      return locate(pt, cursor) != no_region;
+   }
+   // True if the leaves containing pt are in different regions, that is pt
+   // lies on the boundary of a region.
+   bool on_boundary(point_type const&) const;
+   // out[i] = query(pts[i]). The points descend the hierarchy together, one
+   // level per pass, and the children of each node are tested with the
+   // widest containment kernel the CPU supports (or the one given). Only
+   // int32 DAGs within narrow_extent have vector kernels.
+   void query_batch(point_type const* pts, size_t count, uint8_t* out) const;
+   void query_batch(point_type const* pts, size_t count, uint8_t* out,
+         simd_level level) const;
+   // out[i] = locate(pts[i]), the same descent as query_batch.
+   void locate_batch(point_type const* pts, size_t count, region_id* out) const;
+   void locate_batch(point_type const* pts, size_t count, region_id* out,
+         simd_level level) const;
+   size_t size() const { return _size; }
+   size_t bytes() const;                      // of the image, 0 if there is none
+   bool empty() const { return _size == 0; }
+   node_layout layout() const;
+   // Walks the whole hierarchy, linear in its size.
+   dag_shape shape() const;
+private:
+   static constexpr size_t block_size = 1024;    // keeps the per-point state in L1
+
+   template<bool Instrumented>
+   region_id descend(point_type const&, query_stats*) const;
+   void attach(std::shared_ptr<void const> storage, char const* image, size_t bytes);
+   // Throws std::runtime_error unless the attached image is well formed.
+   void check() const;
+   // Up to block_size points of a batch.
+   void locate_block(point_type const* pts, size_t count, region_id* out,
+         containment_kernel<Kernel> contains) const;
+   containment_kernel<Kernel> kernel_for(simd_level level) const {
+      return select_containment_kernel<Kernel>(_narrow ? level : simd_level::scalar);
+   }
+   bool inside(index_type t, point_type const& pt) const {
+      triangle_indices const& tr = _triangles[t];
+      return inside_triangle(_vertices[tr[0]], _vertices[tr[1]], _vertices[tr[2]], pt);
+   }
+   int position(index_type t, point_type const& pt, int& tests) const {
+      triangle_indices const& tr = _triangles[t];
+      return triangle_position(_vertices[tr[0]], _vertices[tr[1]], _vertices[tr[2]], pt, tests);
+   }
+   // triangle_position of the child at c in the CSR child list.
+   int child_position(index_type c, point_type const& pt, int& tests) const {
+      triangle_soa<coord_type> const& s = _child_triangles;
+      return triangle_position(point_type(s.x1[c], s.y1[c]), point_type(s.x2[c], s.y2[c]),
+            point_type(s.x3[c], s.y3[c]), pt, tests);
+   }
+private:
+   std::shared_ptr<void const> _storage;     // heap buffer or mapped_file
+   char const* _image = nullptr;
+   size_t _size = 0;
+   point_type const* _vertices = nullptr;
+   triangle_indices const* _triangles = nullptr;
+   index_type const* _child_offsets = nullptr;
+   index_type const* _child_indices = nullptr;
+   region_id const* _regions = nullptr;       // of leaves, no_region elsewhere
+   bool _narrow = false;                      // vector kernels are exact
+   triangle_soa<coord_type> _child_triangles; // coordinates of _child_indices[i]
+};
+
+typedef basic_flat_dag<default_kernel> flat_dag_type;
@@ -1,68 +1,145 @@
 #include "graph.h"
 
-graph_type::graph_type(point_arr const& special_points):
-   _special_points(special_points) {
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "trace.h"
+
+template<class Kernel>
+basic_graph<Kernel>::basic_graph(point_arr const& special_points) {
    add_poly(special_points);
+   for(auto& f: _flags) f |= special_flag;
+}
+
+template<class Kernel>
+vertex_id basic_graph<Kernel>::add(point_type const& p) {
+   KIRKPATRICK_TRACE(debug, build) << "vertex" << _points.size() << p;
+   _points.push_back(p);
+   _adjacency.emplace_back();
+   _degree.push_back(0);
+   _flags.push_back(0);
+   return vertex_id(_points.size() - 1);
 }
 
-void graph_type::add(point_type const& p) {
-   logger << "Adding point " << p << std::endl;
-   _graph[p] = std::set<point_type>();
+template<class Kernel>
+bool basic_graph<Kernel>::has_edge(vertex_id v, vertex_id u) const {
+   // Outer vertices may have huge lists, look in the shorter one.
+   if(_adjacency[v].size() > _adjacency[u].size()) std::swap(v, u);
+   auto const& adj = _adjacency[v];
+   return std::find(adj.begin(), adj.end(), u) != adj.end();
 }
 
-void graph_type::add_edge(point_type const& p1, point_type const& p2) {
-   logger << "Adding edge " << p1 << " <-> " << p2 << std::endl;
-   if(_graph.find(p1) == _graph.end())
+template<class Kernel>
+void basic_graph<Kernel>::add_edge(vertex_id v, vertex_id u) {
+   KIRKPATRICK_TRACE(debug, build) << "edge" << v << u;
+   if(v >= size() || removed(v))
       throw std::logic_error("first point is not in graph");
-   if(_graph.find(p2) == _graph.end())
+   if(u >= size() || removed(u))
       throw std::logic_error("second point is not in graph");
-   _graph[p1].insert(p2);
-   _graph[p2].insert(p1);
+   if(has_edge(v, u)) return;
+   _adjacency[v].push_back(u);
+   _adjacency[u].push_back(v);
+   ++_degree[v];
+   ++_degree[u];
 }
 
-void graph_type::add_poly(point_arr const& points) {
-   auto fst_point = points.begin();
-   add(*fst_point);
-   auto prev = fst_point;
-   for(auto it = fst_point + 1; it != points.end(); ++it, ++prev) {
-      add(*it);
-      add_edge(*prev, *it);
+template<class Kernel>
+vertex_arr basic_graph<Kernel>::add_poly(point_arr const& points) {
+   vertex_arr res;
+   res.reserve(points.size());
+   for(auto const& p: points) {
+      res.push_back(add(p));
+      if(res.size() > 1) add_edge(res[res.size() - 2], res.back());
    }
-   add_edge(*prev, *fst_point);
+   add_edge(res.back(), res.front());
+   return res;
 }
 
-segment_arr graph_type::edges() const {
+template<class Kernel>
+typename Kernel::segment_arr basic_graph<Kernel>::edges() const {
    segment_arr res;
-   for(auto el: _graph) {
-      auto p1 = el.first;
-      for(auto p2: el.second) {
-         if(p2 < p1) continue;
-         res.push_back(segment_type(p1, p2));
+   for(vertex_id v = 0; v != size(); ++v) {
+      if(removed(v)) continue;
+      for(auto u: _adjacency[v]) {
+         if(u < v || removed(u)) continue;
+         res.push_back(typename Kernel::segment_type(_points[v], _points[u]));
       }
    }
    return res;
 }
 
-point_arr graph_type::independent_set(size_t max_degree) const {
-   point_arr res;
-   std::set<point_type> masked;
-   for(auto pt: _special_points) masked.insert(pt);
-   for(auto el: _graph) {
-      if(el.second.size() > max_degree) continue;
-      if(masked.find(el.first) != masked.end()) continue;
-      masked.insert(el.second.begin(), el.second.end());
-      res.push_back(el.first);
+char const* to_string(independent_set_method method) {
+   switch(method) {
+   case independent_set_method::scan: return "scan";
+   case independent_set_method::min_degree: return "min_degree";
+   case independent_set_method::randomized: return "randomized";
+   }
+   return "?";
+}
+
+// A vertex of low degree leaves a small hole: few new triangles with few
+// children each. Taking those first also blocks fewer neighbours, so the
+// set tends to be larger as well.
+template<class Kernel>
+vertex_arr basic_graph<Kernel>::independent_set(size_t max_degree,
+      independent_set_method method, size_t limit, uint64_t seed) const {
+   vertex_arr candidates;
+   for(vertex_id v = 0; v != size(); ++v) {
+      if(!_flags[v] && _degree[v] <= max_degree) candidates.push_back(v);
    }
+   if(method == independent_set_method::min_degree) {
+      std::stable_sort(candidates.begin(), candidates.end(),
+            [this](vertex_id a, vertex_id b) { return _degree[a] < _degree[b]; });
+   } else if(method == independent_set_method::randomized) {
+      std::mt19937_64 random(seed);
+      std::shuffle(candidates.begin(), candidates.end(), random);
+   }
+   vertex_arr res;
+   std::vector<uint8_t> masked(size(), 0);
+   for(auto v: candidates) {
+      if(res.size() == limit) break;
+      if(masked[v]) continue;
+      for(auto u: _adjacency[v]) masked[u] = 1;
+      res.push_back(v);
+   }
+   return res;
+}
+
+template<class Kernel>
+neighbour_list basic_graph<Kernel>::neighbours(vertex_id v) const {
+   neighbour_list res;
+   res.reserve(_degree[v]);
+   for(auto u: _adjacency[v])
+      if(!removed(u)) res.push_back(u);
    return res;
 }
 
-void graph_type::remove(point_type const& pt) {
-   for(auto el: _graph[pt]) {
-      _graph[el].erase(pt);
+template<class Kernel>
+void basic_graph<Kernel>::compact(vertex_id v) {
+   auto& adj = _adjacency[v];
+   adj.erase(std::remove_if(adj.begin(), adj.end(),
+            [this](vertex_id u) { return removed(u); }), adj.end());
+}
+
+template<class Kernel>
+void basic_graph<Kernel>::remove(vertex_id v) {
+   _flags[v] |= removed_flag;
+   for(auto u: _adjacency[v]) {
+      if(removed(u)) continue;
+      --_degree[u];
+      // Compact once dead ids make up half of the list.
+      if(_adjacency[u].size() > 2 * _degree[u] + 8) compact(u);
    }
-   _graph.erase(pt);
+   _adjacency[v].clear();
+   _adjacency[v].shrink_to_fit();
+   _degree[v] = 0;
 }
 
-void graph_type::remove(point_arr const& pts) {
-   for(auto pt: pts) remove(pt);
+template<class Kernel>
+void basic_graph<Kernel>::remove(vertex_arr const& vs) {
+   for(auto v: vs) remove(v);
 }
+
+#define INSTANTIATE(K) template struct basic_graph<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
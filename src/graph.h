@@ -1,34 +1,75 @@
 #pragma once
 
-#include <map>
-#include <set>
+#include <array>
+#include <cstdint>
+#include <vector>
 
-#include <boost/optional.hpp>
+#include <boost/container/small_vector.hpp>
 
 #include "util.h"
 
-struct graph_type {
-   graph_type(point_arr const& special_points);
-   void add(point_type const&);
-   void add_edge(segment_type const& e) { add_edge(e[0], e[1]); }
-   void add_edge(point_type const&, point_type const&);
-   void add_poly(point_arr const&);
+typedef uint32_t vertex_id;
+typedef std::vector<vertex_id> vertex_arr;
+typedef boost::container::small_vector<vertex_id, 8> neighbour_list;
+typedef std::array<vertex_id, 3> triangle_ids;
+
+// Order in which independent_set() tries the vertices.
+enum class independent_set_method {
+   scan,              // by id, the order they were added in
+   min_degree,        // lowest degree first, ties by id
+   randomized         // shuffled with the given seed
+};
+
+char const* to_string(independent_set_method);
+
+// Vertices are numbered in the order they are added and ids are never reused.
+// remove() only marks a vertex as dead: its id stays in the neighbour lists
+// of the other vertices until they are compacted, and is skipped on reads.
+template<class Kernel>
+struct basic_graph {
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   typedef typename Kernel::segment_arr segment_arr;
+
+   basic_graph(point_arr const& special_points);    // get ids 0 .. size - 1
+   vertex_id add(point_type const&);
+   vertex_arr add_poly(point_arr const&);
+   void add_edge(vertex_id, vertex_id);
+   // Makes v special: it stays out of independent sets.
+   void keep(vertex_id v) { _flags[v] |= special_flag; }
+   point_type const& point(vertex_id v) const { return _points[v]; }
+   size_t size() const { return _points.size(); }   // including removed vertices
+   bool removed(vertex_id v) const { return _flags[v] & removed_flag; }
+   size_t degree(vertex_id v) const { return _degree[v]; }
    segment_arr edges() const;
-   point_arr independent_set(size_t max_degree) const;
-   std::set<point_type> neighbours(point_type const& p) const { return _graph.at(p); }
-   void remove(point_type const&);
-   void remove(point_arr const&);
-   friend std::ostream& operator<<(std::ostream&, graph_type const&);
+   // Greedy independent set of vertices that are neither special nor of a
+   // degree above max_degree, at most limit of them.
+   vertex_arr independent_set(size_t max_degree,
+         independent_set_method = independent_set_method::scan,
+         size_t limit = SIZE_MAX, uint64_t seed = 0) const;
+   neighbour_list neighbours(vertex_id v) const;
+   void remove(vertex_id);
+   void remove(vertex_arr const&);
+private:
+   enum : uint8_t { special_flag = 1, removed_flag = 2 };
+   bool has_edge(vertex_id, vertex_id) const;
+   void compact(vertex_id);
 private:
-   std::map<point_type, std::set<point_type> > _graph;
-   point_arr _special_points;
+   point_arr _points;
+   std::vector<neighbour_list> _adjacency;
+   std::vector<uint32_t> _degree;            // live neighbours
+   std::vector<uint8_t> _flags;
 };
 
-inline std::ostream& operator<<(std::ostream& ost, graph_type const& graph) {
-   for(auto el: graph._graph) {
-      ost << el.first << ":";
-      for(auto p2: el.second) {
-         ost << " " << p2;
+typedef basic_graph<default_kernel> graph_type;
+
+template<class Kernel>
+std::ostream& operator<<(std::ostream& ost, basic_graph<Kernel> const& graph) {
+   for(vertex_id v = 0; v != graph.size(); ++v) {
+      if(graph.removed(v)) continue;
+      ost << graph.point(v) << ":";
+      for(auto u: graph.neighbours(v)) {
+         ost << " " << graph.point(u);
       }
       ost << std::endl;
    }
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "geom/primitives/point.h"
+#include "geom/primitives/segment.h"
+#include "predicates.h"
+
+// A kernel fixes the coordinate type of the whole structure and how its
+// orientation predicate is evaluated:
+//    exact_predicates   the exact sign for any coordinates (predicates.h)
+//    fast_predicates    plain arithmetic in the cheapest type that is exact
+//                       for int32 coordinates spanning less than 2^31,
+//                       rounded for the others
+// The kernel is part of the point type, so the predicates in util.h pick
+// the right arithmetic at compile time by overload.
+
+struct exact_predicates { };
+struct fast_predicates { };
+
+template<class Coord, class Predicates>
+struct kernel;
+
+template<class Kernel>
+struct kernel_point {
+   typedef typename Kernel::coord_type coord_type;
+   kernel_point(): x(), y() { }
+   kernel_point(coord_type x, coord_type y): x(x), y(y) { }
+   coord_type x, y;
+};
+
+template<class Kernel>
+bool operator==(kernel_point<Kernel> const& a, kernel_point<Kernel> const& b) {
+   return a.x == b.x && a.y == b.y;
+}
+
+template<class Kernel>
+bool operator!=(kernel_point<Kernel> const& a, kernel_point<Kernel> const& b) {
+   return !(a == b);
+}
+
+template<class Kernel>
+bool operator<(kernel_point<Kernel> const& a, kernel_point<Kernel> const& b) {
+   return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+template<class Kernel>
+std::ostream& operator<<(std::ostream& ost, kernel_point<Kernel> const& p) {
+   return ost << "(" << p.x << ", " << p.y << ")";
+}
+
+template<class Point>
+struct kernel_segment {
+   kernel_segment(Point const& a, Point const& b) { _points[0] = a; _points[1] = b; }
+   Point const& operator[](size_t i) const { return _points[i]; }
+private:
+   Point _points[2];
+};
+
+template<class Coord, class Predicates>
+struct kernel_geometry {
+   typedef kernel_point<kernel<Coord, Predicates> > point_type;
+   typedef kernel_segment<point_type> segment_type;
+};
+
+// The default kernel works on the geometry library's own types, so the
+// viewer and its file format keep working.
+template<>
+struct kernel_geometry<int32_t, exact_predicates> {
+   typedef geom::structures::point_type point_type;
+   typedef geom::structures::segment_type segment_type;
+};
+
+template<class Coord, class Predicates>
+struct kernel {
+   typedef Coord coord_type;
+   typedef Predicates predicates_type;
+   typedef typename kernel_geometry<Coord, Predicates>::point_type point_type;
+   typedef typename kernel_geometry<Coord, Predicates>::segment_type segment_type;
+   typedef std::vector<point_type> point_arr;
+   typedef std::vector<segment_type> segment_arr;
+
+   static_assert(std::is_same<Coord, int32_t>::value || std::is_same<Coord, int64_t>::value ||
+         std::is_same<Coord, float>::value || std::is_same<Coord, double>::value,
+         "coordinates are int32_t, int64_t, float or double");
+
+   static bool const exact = std::is_same<Predicates, exact_predicates>::value;
+
+   // 1 for a left turn p1 -> p2 -> p3, -1 for a right turn, 0 if collinear.
+   static int orientation(point_type const& p1, point_type const& p2, point_type const& p3) {
+      if(exact)
+         return predicates::orientation(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y);
+      return predicates::fast_orientation(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y);
+   }
+};
+
+typedef kernel<int32_t, fast_predicates> int32_kernel;
+typedef kernel<int32_t, exact_predicates> int32_exact_kernel;
+typedef kernel<int64_t, fast_predicates> int64_kernel;
+typedef kernel<int64_t, exact_predicates> int64_exact_kernel;
+typedef kernel<float, fast_predicates> float_kernel;
+typedef kernel<float, exact_predicates> float_exact_kernel;
+typedef kernel<double, fast_predicates> double_kernel;
+typedef kernel<double, exact_predicates> double_exact_kernel;
+
+typedef int32_exact_kernel default_kernel;
+
+// The templates taking a kernel are defined in their .cpp files and
+// instantiated there for each of these.
+#define KIRKPATRICK_FOR_EACH_KERNEL(X) \
+   X(int32_kernel) X(int32_exact_kernel) X(int64_kernel) X(int64_exact_kernel) \
+   X(float_kernel) X(float_exact_kernel) X(double_kernel) X(double_exact_kernel)
+
+template<class Kernel>
+int orientation(kernel_point<Kernel> const& p1, kernel_point<Kernel> const& p2,
+      kernel_point<Kernel> const& p3) {
+   return Kernel::orientation(p1, p2, p3);
+}
+
+// Sign of the determinant
+// 1   1   1
+// p1x p2x p3x
+// p1y p2y p3y
+// for the library's points, computed exactly.
+inline int orientation(geom::structures::point_type const& p1,
+      geom::structures::point_type const& p2, geom::structures::point_type const& p3) {
+   return default_kernel::orientation(p1, p2, p3);
+}
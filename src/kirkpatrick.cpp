@@ -1,209 +1,505 @@
-#pragma comment( lib, "OpenGL32.lib" )
-#include <algorithm> // for std::max in "geom/primitives/vector.h"
-#include "geom/primitives/vector.h"
-
-using geom::structures::vector_type;
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
 
+#include "arena.h"
 #include "kirkpatrick.h"
+#include "point_grid.h"
+#include "subdivision.h"
+#include "thread_pool.h"
+#include "trace.h"
 
 
-const size_t MAX_DEGREE = 8;
+// Holes of vertices up to this degree keep their triangle lists inline.
+const size_t INLINE_DEGREE = 8;
+// Convex hulls of framed builds up to this size are kept as the top level.
+const size_t MAX_TOP_HULL = 16;
 
-typedef std::set<std::shared_ptr<triangle_type> > triangle_set;
+template<class Kernel>
+using triangle_set = std::pmr::set<basic_triangle_ptr<Kernel> >;
 
-std::ostream& operator<<(std::ostream& ost, triangle_set const& triangles) {
-   for(auto i: triangles) {
-      ost << "   " << *i << std::endl;
-   }
-   return ost;
-}
+// Triangles incident to each vertex, indexed by vertex_id. The sets take
+// their nodes from the resource the map is constructed with.
+template<class Kernel>
+using triangle_map = std::pmr::vector<triangle_set<Kernel> >;
 
-typedef std::map<point_type, triangle_set> triangle_map;
+// Triangles come from the arena if there is one, their children lists too.
+template<class Kernel>
+basic_triangle_ptr<Kernel> make_triangle(build_arena* arena, size_t thread,
+      typename Kernel::point_type const& p1, typename Kernel::point_type const& p2,
+      typename Kernel::point_type const& p3, region_id region) {
+   if(!arena)
+      return std::make_shared<basic_triangle<Kernel> >(p1, p2, p3, region);
+   return arena->make_shared<basic_triangle<Kernel> >(thread, p1, p2, p3, region,
+         arena->resource(thread));
+}
 
-std::ostream& operator << (std::ostream& ost, triangle_map const& triangles) {
-   for(auto i: triangles) {
-      ost << i.first << ":" << std::endl << i.second;
-   }
-   return ost;
+template<class Kernel>
+void add_triangle(basic_graph<Kernel>& graph, vertex_id v1, vertex_id v2, vertex_id v3,
+      region_id region, triangle_map<Kernel>& triangles, build_arena* arena) {
+   auto const& p1 = graph.point(v1);
+   auto const& p2 = graph.point(v2);
+   auto const& p3 = graph.point(v3);
+   KIRKPATRICK_TRACE(debug, build) << "triangle" << v1 << v2 << v3 << "region" << region;
+   graph.add_edge(v1, v2);
+   graph.add_edge(v2, v3);
+   graph.add_edge(v3, v1);
+   auto t = make_triangle<Kernel>(arena, 0, p1, p2, p3, region);
+   triangles[v1].insert(t);
+   triangles[v2].insert(t);
+   triangles[v3].insert(t);
 }
 
-void add_triangle(graph_type& graph, point_type const& p1, point_type const& p2,
-      point_type const& p3, bool is_inside, triangle_map& triangles,
-      triangle_set& generated_triangles) {
-   logger << "Adding triangle " << p1 << " " << p2 << " " << p3 << std::endl;
-   graph.add_edge(p1, p2);
-   graph.add_edge(p2, p3);
-   graph.add_edge(p3, p1);
-   auto t = std::make_shared<triangle_type>(p1, p2, p3, is_inside);
-   triangles[p1].insert(t);
-   triangles[p2].insert(t);
-   triangles[p3].insert(t);
-   generated_triangles.insert(t);
+template<class Kernel>
+typename Kernel::point_arr points_of(basic_graph<Kernel> const& graph, vertex_arr const& vs) {
+   typename Kernel::point_arr res;
+   res.reserve(vs.size());
+   for(auto v: vs) res.push_back(graph.point(v));
+   return res;
 }
 
 // Ear clipping.
 // see https://www.geometrictools.com/Documentation/TriangulationByEarClipping.pdf
+// If grid is given (built over the polygon's points) it replaces the linear scans.
+// Only computes the triangles, the graph is left untouched.
 
-void triangulate_polygon(point_arr const& points, graph_type& graph,
-      triangle_map& triangles, bool is_inside,
-      triangle_set& generated_triangles) {
-   point_arr avail_points;
-   for(auto pt: points) {                     // sequentially clipping ears
+template<class Kernel>
+std::vector<triangle_ids> clip_ears(vertex_arr const& poly, basic_graph<Kernel> const& graph,
+      basic_point_grid<Kernel> const* grid = nullptr) {
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   std::vector<triangle_ids> res;
+   point_arr const points = grid ? point_arr() : points_of(graph, poly);
+   vertex_arr avail_points;
+   for(auto v: poly) {                        // sequentially clipping ears
+      point_type const& pt = graph.point(v);
       while(avail_points.size() > 1) {
          auto jt = avail_points.rbegin();
-         if(!is_ear(*(jt + 1), *jt, pt, points))
+         point_type const& p1 = graph.point(*(jt + 1));
+         point_type const& p2 = graph.point(*jt);
+         if(grid ? !is_ear(p1, p2, pt, *grid) : !is_ear(p1, p2, pt, points))
              break;
-         logger << *(jt + 1) << *jt << pt << " is an ear" << std::endl;
-         add_triangle(graph, *(jt + 1), *jt, pt, is_inside, triangles,
-               generated_triangles);
+         KIRKPATRICK_TRACE(debug, build) << "ear" << *(jt + 1) << *jt << v;
+         res.push_back({{ *(jt + 1), *jt, v }});
          avail_points.pop_back();
       }
-      logger << "Adding " << pt << " to avail_points" << std::endl;
-      avail_points.push_back(pt);
+      avail_points.push_back(v);
    }
+   return res;
+}
+
+template<class Kernel>
+void triangulate_polygon(vertex_arr const& poly, basic_graph<Kernel>& graph,
+      triangle_map<Kernel>& triangles, region_id region,
+      build_arena* arena, basic_point_grid<Kernel> const* grid = nullptr) {
+   for(auto const& t: clip_ears(poly, graph, grid))
+      add_triangle(graph, t[0], t[1], t[2], region, triangles, arena);
 }
 
-void triangulate_pockets(point_arr const& points, graph_type& graph,
-      point_arr& convex_hull, triangle_map& triangles) {
-   triangle_set tmp;
+template<class Kernel>
+void triangulate_pockets(vertex_arr const& poly, basic_graph<Kernel>& graph,
+      vertex_arr& convex_hull, triangle_map<Kernel>& triangles, build_arena* arena,
+      basic_point_grid<Kernel> const* grid = nullptr) {
+   typedef typename Kernel::point_type point_type;
+   auto const points = points_of(graph, poly);
    size_t leftmost = 0;
    for(size_t i = 0; i != points.size(); ++i) {
       if(points[i].x < points[leftmost].x) leftmost = i;
    }
-   logger << points[leftmost] << " is the leftmost" << std::endl;
+   KIRKPATRICK_TRACE(debug, build) << "leftmost" << poly[leftmost] << points[leftmost];
    size_t i = leftmost;
-   convex_hull.push_back(points[(i++) % points.size()]);
-   logger << "Pushing " << convex_hull.back() << " to convex_hull" << std::endl;
-   convex_hull.push_back(points[(i++) % points.size()]);
-   logger << "Pushing " << convex_hull.back() << " to convex_hull" << std::endl;
-   for(; i - leftmost != points.size() + 1; ++i) {
-      auto pt = points[i % points.size()];
+   convex_hull.push_back(poly[(i++) % poly.size()]);
+   convex_hull.push_back(poly[(i++) % poly.size()]);
+   for(; i - leftmost != poly.size() + 1; ++i) {
+      vertex_id v = poly[i % poly.size()];
+      point_type const& pt = graph.point(v);
       while(convex_hull.size() > 1) {
          auto jt = convex_hull.rbegin();               // jt is the last item in convex hull, jt+1 is a previous one
-         if(!is_right_turn(*(jt + 1), *jt, pt))        // if right turn, then it's supposedly a pocket
+         point_type const& last = graph.point(*jt);
+         point_type const& prev = graph.point(*(jt + 1));
+         if(!is_right_turn(prev, last, pt))            // if right turn, then it's supposedly a pocket
              break;
          bool res = true;
-         for(auto p: points) {                                       // check that no more points lie in this triangle
-            if(p == *(jt + 1) || p == *jt || p == pt) continue;
-            if(inside_triangle(pt, *jt, *(jt + 1), p)) { res = false; break; }
+         if(grid) res = !grid->any_inside(pt, last, prev);
+         else for(auto p: points) {                                  // check that no more points lie in this triangle
+            if(p == prev || p == last || p == pt) continue;
+            if(inside_triangle(pt, last, prev, p)) { res = false; break; }
          }
          if(!res) break;
-         logger << pt << *jt << *(jt + 1) << " is a pocket" << std::endl;   // it is a pocket
-         add_triangle(graph, pt, *jt, *(jt + 1), false, triangles, tmp);       // add this pocket to graph as a triangle
-         logger << "Popping " << convex_hull.back() << " from convex_hull" << std::endl;
+         KIRKPATRICK_TRACE(debug, build) << "pocket" << v << *jt << *(jt + 1);
+         add_triangle(graph, v, *jt, *(jt + 1), no_region, triangles, arena);    // add this pocket to graph as a triangle
          convex_hull.pop_back();               // because it is a pocket, last vertex on convex hull won't do
       }
-      convex_hull.push_back(pt);
-      logger << "Pushing " << pt << " to convex_hull" << std::endl;
+      convex_hull.push_back(v);
    }
 }
 
-// convex_hull and outer_points are counter-clockwise
-void triangulate_with_outer_triangle(point_arr const& convex_hull,
-      point_arr const& outer_points, graph_type& graph, triangle_map& triangles) {
-   triangle_set tmp;
+// convex_hull and outer_points are counter-clockwise, outer_points is a
+// convex ring round the hull whose last and first vertex the leftmost hull
+// vertex sees, like the left edge of the outer triangle.
+template<class Kernel>
+void triangulate_with_outer_ring(vertex_arr const& convex_hull,
+      vertex_arr const& outer_points, basic_graph<Kernel>& graph, triangle_map<Kernel>& triangles,
+      build_arena* arena) {
+   typedef typename Kernel::point_type point_type;
+   auto hull = [&](size_t i) -> point_type const& {
+      return graph.point(convex_hull[i % convex_hull.size()]);
+   };
+   auto outer = [&](size_t i) -> point_type const& { return graph.point(outer_points[i]); };
    // First point on convex_hull is leftmost.
    // Therefore it sees first and last out of outer_points.
-   add_triangle(graph, convex_hull[0], outer_points[2], outer_points[0], false,
-         triangles, tmp);
+   size_t const last = outer_points.size() - 1;
+   add_triangle(graph, convex_hull[0], outer_points[last], outer_points[0], no_region,
+         triangles, arena);
+   // The leftmost point may already be the last one to see outer_points[0].
    size_t last_seen = 0;
-   for(size_t i = 1; i != convex_hull.size(); ++i) {
-      logger << "Looking at " << convex_hull[i] << std::endl;
-      if(is_left_turn(outer_points[last_seen], convex_hull[i], convex_hull[i - 1])) {
-         logger << "It sees " << last_seen << std::endl;
+   for(size_t i = 0; i != convex_hull.size(); ++i) {
+      if(i != 0 && is_left_turn(outer(last_seen), hull(i), hull(i - 1))) {
+         KIRKPATRICK_TRACE(debug, build) << "hull" << convex_hull[i] << "sees outer" << last_seen;
          add_triangle(graph, convex_hull[i - 1], outer_points[last_seen], convex_hull[i],
-               false, triangles, tmp);
+               no_region, triangles, arena);
       }
-      if(last_seen == 2) continue;
-      if(is_right_turn(outer_points[last_seen + 1], convex_hull[i], convex_hull[i + 1])) {
-         logger << "And it sees " << last_seen + 1 << std::endl;
+      // A hull vertex may see several outer ones.
+      while(last_seen != last && is_right_turn(outer(last_seen + 1), hull(i), hull(i + 1))) {
+         KIRKPATRICK_TRACE(debug, build) << "hull" << convex_hull[i] << "sees outer"
+               << last_seen + 1;
          add_triangle(graph, outer_points[last_seen], outer_points[last_seen + 1],
-            convex_hull[i], false, triangles, tmp);
+            convex_hull[i], no_region, triangles, arena);
          last_seen += 1;
       }
    }
 }
 
-void initial_triangulation(point_arr const& points, point_arr const& outer_points,
-      graph_type& graph, triangle_map& triangles) {
-   logger << "Triangulating polygon" << std::endl;
-   triangle_set tris;
-   triangulate_polygon(points, graph, triangles, true, tris);
-   point_arr convex_hull;
-   logger << "Triangulating pockets" << std::endl;
-   triangulate_pockets(points, graph, convex_hull, triangles);
-   logger << "Triangulating with outer triangle" << std::endl;
-   triangulate_with_outer_triangle(convex_hull, outer_points, graph, triangles);
-}
-
-
-void retriangulate(point_arr& poly, point_type const& pt,          // poly is counter-clockwise points that surround pt
-      graph_type& graph, triangle_map& triangles) {
-   triangle_set const old_triangles(triangles[pt]);
-   logger << "Retriangulation for " << pt << ". Old set: " << std::endl;
-   logger << old_triangles << std::endl;
-   triangle_set new_triangles;
-   triangulate_polygon(poly, graph, triangles, false, new_triangles);   // _is_inside variable for new triangles does not matter cause they all will have children
-   logger << "New set " << std::endl << new_triangles << std::endl;
-   for(auto ot: old_triangles) {
-      for(auto nt: new_triangles) {
-         if(intersects(*ot, *nt)) {
-            nt->add_child(ot);
-            logger << "Intersection between " << *ot << " and " << *nt << std::endl;
-         }
+// The polygon and its pockets, that is its convex hull. The hull starts
+// and ends with the leftmost vertex.
+template<class Kernel>
+void triangulate_hull(vertex_arr const& poly, basic_graph<Kernel>& graph,
+      triangle_map<Kernel>& triangles, triangulation_method method, build_arena* arena,
+      vertex_arr& convex_hull) {
+   std::unique_ptr<basic_point_grid<Kernel> > grid;
+   if(method == triangulation_method::grid_ear_clipping)
+      grid.reset(new basic_point_grid<Kernel>(points_of(graph, poly)));
+   KIRKPATRICK_TRACE(info, build) << "triangulating polygon of" << poly.size() << "vertices";
+   triangulate_polygon(poly, graph, triangles, 0, arena, grid.get());
+   KIRKPATRICK_TRACE(info, build) << "triangulating pockets";
+   triangulate_pockets(poly, graph, convex_hull, triangles, arena, grid.get());
+}
+
+template<class Kernel>
+void initial_triangulation(vertex_arr const& poly, vertex_arr const& outer_points,
+      basic_graph<Kernel>& graph, triangle_map<Kernel>& triangles, triangulation_method method,
+      build_arena* arena) {
+   vertex_arr convex_hull;
+   triangulate_hull(poly, graph, triangles, method, arena, convex_hull);
+   KIRKPATRICK_TRACE(info, build) << "triangulating hull of" << convex_hull.size()
+         << "vertices with the outer triangle";
+   triangulate_with_outer_ring(convex_hull, outer_points, graph, triangles, arena);
+}
+
+
+// Neighbours of v counter-clockwise, starting where angle_less does. The
+// triangles around v are its ring already: each one links its other two
+// corners in the order its orientation gives, and the links are followed
+// from the first neighbour. Sorts instead if they do not close a ring.
+template<class Kernel>
+vertex_arr neighbour_ring(basic_graph<Kernel> const& graph, triangle_map<Kernel> const& triangles,
+      vertex_id v) {
+   typedef typename Kernel::point_type point_type;
+   neighbour_list const ns = graph.neighbours(v);
+   point_type const& pt = graph.point(v);
+   size_t const degree = ns.size();
+   auto index_of = [&](point_type const& p) {
+      size_t i = 0;
+      while(i != degree && graph.point(ns[i]) != p) ++i;
+      return i;
+   };
+   boost::container::small_vector<size_t, INLINE_DEGREE> next(degree, degree);
+   bool ring = triangles[v].size() == degree;
+   for(auto it = triangles[v].begin(); ring && it != triangles[v].end(); ++it) {
+      point_type const* corners[3] = { &(*it)->p1(), &(*it)->p2(), &(*it)->p3() };
+      point_type const* others[2];
+      size_t k = 0;
+      for(auto c: corners) {
+         if(*c != pt && k != 2) others[k++] = c;
       }
-      for(auto& el: triangles) {
-         logger << "Erasing " << *ot << " from " << el.first << std::endl;
-         size_t res = el.second.erase(ot);
-         logger << "Erased " << res << std::endl;
+      int const o = k == 2 ? orientation(pt, *others[0], *others[1]) : 0;
+      if(o == 0) {
+         ring = false;
+         break;
       }
+      size_t a = index_of(*others[0]), b = index_of(*others[1]);
+      if(o < 0) std::swap(a, b);
+      ring = a != degree && b != degree && next[a] == degree;
+      if(ring) next[a] = b;
+   }
+   size_t first = 0;
+   for(size_t i = 1; i != degree; ++i) {
+      if(angle_less(pt, graph.point(ns[i]), graph.point(ns[first]))) first = i;
    }
-   triangles.erase(pt);
+   vertex_arr res;
+   res.reserve(degree);
+   boost::container::small_vector<bool, INLINE_DEGREE> seen(degree, false);
+   size_t i = first;
+   while(ring && res.size() != degree) {
+      ring = i != degree && !seen[i];
+      if(ring) {
+         seen[i] = true;
+         res.push_back(ns[i]);
+         i = next[i];
+      }
+   }
+   if(!ring || i != first) {
+      KIRKPATRICK_TRACE(debug, refine) << "triangles around" << v << "make no ring, sorting";
+      res.assign(ns.begin(), ns.end());
+      std::sort(res.begin(), res.end(), [&](vertex_id v1, vertex_id v2) {
+         return angle_less(pt, graph.point(v1), graph.point(v2));
+      });
+   }
+   return res;
 }
 
+// Replacement of the triangles around one removed vertex.
+template<class Kernel>
+struct hole_patch {
+   typedef boost::container::small_vector<basic_triangle_ptr<Kernel>, INLINE_DEGREE> triangle_list;
+   vertex_id v;
+   vertex_arr poly;                   // counter-clockwise neighbours of v
+   triangle_list old_triangles;
+   std::vector<triangle_ids> new_ids;
+   triangle_list new_triangles;
+};
 
-bool refine(graph_type& graph, triangle_map& triangles) {
-   point_arr iset = graph.independent_set(MAX_DEGREE);
-   if(iset.empty())
-       return false;
-   logger << "Found independent set of size " << iset.size() << std::endl;
-   for(auto pt: iset) {
-      logger << "Working on " << pt << std::endl;
-      point_arr poly = sort_counter_clockwise(pt, graph.neighbours(pt));
-      logger << "Neighbours: ";
-      for(auto p: poly) {
-         logger << p << " ";
+// Only reads graph and triangles. The vertices of an independent set are not
+// adjacent, so their holes share neither old triangles nor new diagonals and
+// the patches of one level can be built in any order, or concurrently.
+template<class Kernel>
+hole_patch<Kernel> triangulate_hole(vertex_id v, basic_graph<Kernel> const& graph,
+      triangle_map<Kernel> const& triangles, build_arena* arena, size_t thread) {
+   hole_patch<Kernel> patch;
+   patch.v = v;
+   patch.poly = neighbour_ring(graph, triangles, v);
+   patch.old_triangles.assign(triangles[v].begin(), triangles[v].end());
+   KIRKPATRICK_TRACE(debug, refine) << "hole of" << v << graph.point(v) << "degree"
+         << patch.poly.size();
+   patch.new_ids = clip_ears(patch.poly, graph);
+   for(auto const& t: patch.new_ids) {
+      // the region of new triangles does not matter cause they all will have children
+      auto nt = make_triangle<Kernel>(arena, thread, graph.point(t[0]), graph.point(t[1]),
+            graph.point(t[2]), no_region);
+      // Collected first, so that the children list is allocated once.
+      typename hole_patch<Kernel>::triangle_list children;
+      for(auto const& ot: patch.old_triangles) {
+         if(intersects(*ot, *nt)) children.push_back(ot);
       }
-      logger << std::endl;
-      retriangulate(poly, pt, graph, triangles);
+      nt->add_children(children);
+      KIRKPATRICK_TRACE(debug, refine) << "new triangle" << t[0] << t[1] << t[2] << "children"
+            << nt->children().size();
+      patch.new_triangles.push_back(nt);
+   }
+   return patch;
+}
+
+template<class Kernel>
+void retriangulate(hole_patch<Kernel> const& patch, basic_graph<Kernel>& graph,
+      triangle_map<Kernel>& triangles) {
+   for(size_t i = 0; i != patch.new_ids.size(); ++i) {
+      triangle_ids const& t = patch.new_ids[i];
+      graph.add_edge(t[0], t[1]);
+      graph.add_edge(t[1], t[2]);
+      graph.add_edge(t[2], t[0]);
+      for(auto u: t) triangles[u].insert(patch.new_triangles[i]);
    }
+   for(auto const& ot: patch.old_triangles) {
+      // ot is incident to v, so its other two vertices are on poly.
+      for(auto u: patch.poly) triangles[u].erase(ot);
+   }
+   triangles[patch.v].clear();
+}
+
+// Removes an independent set of at most limit vertices. Returns its size, 0
+// once there is nothing left to remove.
+template<class Kernel>
+size_t refine(basic_graph<Kernel>& graph, triangle_map<Kernel>& triangles, work_stealing_pool* pool,
+      build_arena* arena, build_options const& options, size_t limit, uint64_t seed) {
+   vertex_arr iset = graph.independent_set(options.max_degree, options.independent_set, limit,
+         seed);
+   if(iset.empty())
+       return 0;
+   KIRKPATRICK_TRACE(info, refine) << "independent set of" << iset.size() << "vertices";
+   std::vector<hole_patch<Kernel> > patches(iset.size());
+   if(pool && iset.size() > 1) {
+      // Each task fills its own slots of patches, they are merged below.
+      size_t const chunk = 64;
+      pool->run((iset.size() + chunk - 1) / chunk, [&](size_t task, size_t worker) {
+         for(size_t i = task * chunk; i != std::min(iset.size(), (task + 1) * chunk); ++i)
+            patches[i] = triangulate_hole(iset[i], graph, triangles, arena, worker + 1);
+      });
+   } else {
+      for(size_t i = 0; i != iset.size(); ++i)
+         patches[i] = triangulate_hole(iset[i], graph, triangles, arena, 0);
+   }
+   for(auto const& patch: patches)
+      retriangulate(patch, graph, triangles);
    graph.remove(iset);
-   logger << "Removed independent set" << std::endl;
-   return true;
+   return iset.size();
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 }
 
-std::shared_ptr<triangle_type> refinement(graph_type& graph, triangle_map& triangles) {
+template<class Kernel>
+basic_triangle_ptr<Kernel> refinement(basic_graph<Kernel>& graph, triangle_map<Kernel>& triangles,
+      build_options const& options, build_profile& profile, build_arena* arena) {
+   // Below degree 6 the vertices left may all be out of reach.
+   if(options.max_degree < 6)
+      throw std::invalid_argument("max_degree below 6");
+   if(!(options.removal_fraction > 0 && options.removal_fraction <= 1))
+      throw std::invalid_argument("removal_fraction outside (0, 1]");
+   std::unique_ptr<work_stealing_pool> pool;
+   if(options.threads != 1)
+      pool.reset(new work_stealing_pool(options.threads));
+   if(pool && arena) arena->add_workers(pool->size());
+   size_t vertices = graph.size();          // nothing is removed yet
    for(;;) {
-      if(!refine(graph, triangles))
+      auto start = std::chrono::steady_clock::now();
+      size_t const limit = std::max<size_t>(1, size_t(options.removal_fraction * vertices));
+      uint64_t const seed = options.seed + profile.levels.size() * 0x9e3779b97f4a7c15ull;
+      size_t const removed = refine(graph, triangles, pool.get(), arena, options, limit, seed);
+      if(!removed)
           break;
+      profile.levels.push_back({ vertices, removed, seconds_since(start) });
+      vertices -= removed;
    }
-   return *(triangles.begin()->second.begin());        // by this time we only have an outer triangle
+   // By this time only the outer triangle is left, unless it was never
+   // part of the triangulation.
+   return triangles[0].empty() ? nullptr : *triangles[0].begin();
 }
 
-point_arr find_outer_triangle(point_arr const& points) {
-   point_arr res;
-   point_type lower_left;
-   int32_t c = 0;
+// Top of a framed build: the outer triangle over the triangles left,
+// which cover the hull or its bounding box.
+template<class Kernel>
+basic_triangle_ptr<Kernel> frame_top(basic_graph<Kernel> const& graph,
+      triangle_map<Kernel> const& triangles, typename Kernel::point_arr const& outer,
+      build_arena* arena) {
+   std::vector<basic_triangle_ptr<Kernel> > left;
+   for(vertex_id v = 0; v != graph.size(); ++v) {
+      if(!graph.removed(v)) left.insert(left.end(), triangles[v].begin(), triangles[v].end());
+   }
+   std::sort(left.begin(), left.end());
+   left.erase(std::unique(left.begin(), left.end()), left.end());
+   auto top = make_triangle<Kernel>(arena, 0, outer[0], outer[1], outer[2], no_region);
+   top->add_children(left);
+   KIRKPATRICK_TRACE(info, build) << "hull of" << left.size() << "triangles under the frame";
+   return top;
+}
+
+// Adds a boundary of region to graph and its edges to edges, turned so that
+// the region is on their left: counter-clockwise for an outer boundary,
+// clockwise for a hole. Rings may share vertices, each point gets one.
+template<class Kernel>
+void add_ring(basic_graph<Kernel>& graph, std::map<typename Kernel::point_type, vertex_id>& ids,
+      typename Kernel::point_arr const& ring, bool outer, region_id region,
+      std::vector<region_edge>& edges) {
+   if(ring.size() < 3)
+      throw std::invalid_argument("ring with less than three points");
+   vertex_arr poly;
+   for(auto const& pt: ring) {
+      auto it = ids.find(pt);
+      if(it == ids.end()) it = ids.emplace(pt, graph.add(pt)).first;
+      poly.push_back(it->second);
+   }
+   if(is_counter_clockwise(ring) != outer)
+      std::reverse(poly.begin(), poly.end());
+   for(size_t i = 0; i != poly.size(); ++i) {
+      vertex_id a = poly[i], b = poly[(i + 1) % poly.size()];
+      if(a != b) edges.push_back({ a, b, region });
+   }
+}
+
+// Triangulation of the outer triangle that keeps the region edges, see
+// triangulate_subdivision.
+template<class Kernel>
+void initial_triangulation(basic_graph<Kernel>& graph, std::vector<region_edge> const& edges,
+      triangle_map<Kernel>& triangles, build_arena* arena) {
+   typename Kernel::point_arr points;
+   for(vertex_id v = 0; v != graph.size(); ++v) points.push_back(graph.point(v));
+   for(auto const& t: triangulate_subdivision<Kernel>(points, edges))
+      add_triangle(graph, t.ids[0], t.ids[1], t.ids[2], t.region, triangles, arena);
+   KIRKPATRICK_TRACE(info, build) << "triangulated" << graph.size() << "vertices and"
+         << edges.size() << "region edges";
+}
+
+// Where one build allocates. With build_options::arena the triangles come
+// from an arena they keep alive, and the incidence sets from scratch memory
+// released when the build is done. Otherwise both are on the heap.
+struct build_memory {
+   explicit build_memory(bool arena) {
+      if(arena) this->arena = std::make_shared<build_arena>();
+   }
+   std::pmr::memory_resource* sets() {
+      return arena ? scratch.resource(0) : std::pmr::get_default_resource();
+   }
+   void report(build_profile& profile) const {
+      if(!arena) return;
+      profile.arena_bytes = arena->bytes();
+      profile.scratch_bytes = scratch.bytes();
+   }
+
+   std::shared_ptr<build_arena> arena;
+   build_arena scratch;
+};
+
+template<class Point>
+std::vector<Point> concatenate(std::vector<std::vector<Point> > const& rings) {
+   std::vector<Point> res;
+   for(auto const& ring: rings) res.insert(res.end(), ring.begin(), ring.end());
+   return res;
+}
+
+// Coordinates wide enough for the sum of two Coord without overflow.
+template<class Coord> struct wide_coord { typedef Coord type; };
+template<> struct wide_coord<int32_t> { typedef int64_t type; };
+#ifdef __SIZEOF_INT128__
+template<> struct wide_coord<int64_t> { typedef __int128 type; };
+#else
+template<> struct wide_coord<int64_t> { typedef long double type; };
+#endif
+
+// Computed in wide coordinates, the outer triangle spans about twice the polygon.
+template<class Kernel>
+typename Kernel::point_arr find_outer_triangle(typename Kernel::point_arr const& points) {
+   typedef typename Kernel::coord_type coord_type;
+   typedef typename Kernel::point_type point_type;
+   typedef typename wide_coord<coord_type>::type wide_type;
+   wide_type x = 0, y = 0, c = 0;          // lower left corner and max x + y
    for(auto pt: points) {
-      if(pt.x < lower_left.x) lower_left.x = pt.x;
-      if(pt.y < lower_left.y) lower_left.y = pt.y;
-      if(pt.x + pt.y > c) c = pt.x + pt.y;
+      x = std::min<wide_type>(x, pt.x);
+      y = std::min<wide_type>(y, pt.y);
+      c = std::max<wide_type>(c, wide_type(pt.x) + pt.y);
    }
-   lower_left += vector_type(-10,-10);
+   x -= 10;
+   y -= 10;
    c += 10;
-   res.push_back(lower_left);
-   res.push_back(point_type(c - lower_left.y, lower_left.y));
-   res.push_back(point_type(lower_left.x, c - lower_left.x));
+   for(wide_type v: { x, y, c - y, c - x }) {
+      bool fits;
+      if constexpr(std::is_integral<coord_type>::value)
+         fits = v >= std::numeric_limits<coord_type>::min() && v <= std::numeric_limits<coord_type>::max();
+      else
+         fits = std::isfinite(coord_type(v));
+      if(!fits)
+         throw std::out_of_range("polygon coordinates leave no room for the outer triangle");
+   }
+   typename Kernel::point_arr res;
+   res.push_back(point_type(coord_type(x), coord_type(y)));
+   res.push_back(point_type(coord_type(c - y), coord_type(y)));
+   res.push_back(point_type(coord_type(x), coord_type(c - x)));
 
    // let c = x3 + y3 -> max
    // let's prove this triangle surrounds the polygon
@@ -217,39 +513,141 @@ point_arr find_outer_triangle(point_arr const& points) {
    return res;
 }
 
-kirkpatrick_type::kirkpatrick_type(point_arr const& points):
-   _outer_points(find_outer_triangle(points)),
-   _graph(_outer_points), tr_drawer() {
-   logger << "Starting kirkpatrick" << std::endl;
-   _graph.add_poly(points);
-   logger << "Bootstrapped graph: " << std::endl << _graph << std::endl;
+template<class Kernel>
+basic_kirkpatrick<Kernel>::basic_kirkpatrick(point_arr const& points, build_options const& options):
+   _outer_points(find_outer_triangle<Kernel>(points)),
+   _graph(_outer_points) {
+   KIRKPATRICK_TRACE(info, build) << "polygon of" << points.size() << "vertices";
+   auto start = std::chrono::steady_clock::now();
+   vertex_arr poly = _graph.add_poly(points);
 
-   point_arr points_copy = points;
    if(!is_counter_clockwise(points)) {
-      logger << "Polygon was clockwise" << std::endl;
-      std::reverse_copy(points.begin(), points.end(), points_copy.begin());
+      KIRKPATRICK_TRACE(debug, build) << "polygon is clockwise";
+      std::reverse(poly.begin(), poly.end());
    }
 
-   triangle_map triangles;
-   initial_triangulation(points_copy, _outer_points, _graph, triangles);
-   logger << "Triangulated graph: " << std::endl << _graph << std::endl;
+   vertex_arr const outer_points = { 0, 1, 2 };       // _graph was created from _outer_points
+   build_memory memory(options.arena);
+   triangle_map<Kernel> triangles(_graph.size(), memory.sets());
+   initial_triangulation(poly, outer_points, _graph, triangles, options.triangulation,
+         memory.arena.get());
    _triangulation = _graph.edges();
-   logger << triangles << std::endl;
-   _top_triangle = refinement(_graph, triangles);
+   _profile.triangulation = seconds_since(start);
+   _top_triangle = refinement(_graph, triangles, options, _profile, memory.arena.get());
+   freeze(options.layout);
+   memory.report(_profile);
+}
 
-   logger << "Got top triangle" << std::endl;
+template<class Kernel>
+basic_kirkpatrick<Kernel>::basic_kirkpatrick(point_arr const& outer,
+      std::vector<point_arr> const& holes, build_options const& options):
+   _outer_points(find_outer_triangle<Kernel>(outer)),
+   _graph(_outer_points) {
+   KIRKPATRICK_TRACE(info, build) << "polygon of" << outer.size() << "vertices with"
+         << holes.size() << "holes";
+   auto start = std::chrono::steady_clock::now();
+   std::map<point_type, vertex_id> ids;
+   std::vector<region_edge> edges;
+   add_ring(_graph, ids, outer, true, 0, edges);
+   for(auto const& hole: holes)
+      add_ring(_graph, ids, hole, false, 0, edges);
+   build_memory memory(options.arena);
+   triangle_map<Kernel> triangles(_graph.size(), memory.sets());
+   initial_triangulation(_graph, edges, triangles, memory.arena.get());
+   _triangulation = _graph.edges();
+   _profile.triangulation = seconds_since(start);
+   _top_triangle = refinement(_graph, triangles, options, _profile, memory.arena.get());
+   freeze(options.layout);
+   memory.report(_profile);
 }
 
-bool kirkpatrick_type::query(point_type const& pt) const {
-   return _top_triangle->query(pt);
+template<class Kernel>
+basic_kirkpatrick<Kernel>::basic_kirkpatrick(std::vector<point_arr> const& regions,
+      build_options const& options):
+   _outer_points(find_outer_triangle<Kernel>(concatenate(regions))),
+   _graph(_outer_points) {
+   KIRKPATRICK_TRACE(info, build) << "subdivision of" << regions.size() << "regions";
+   auto start = std::chrono::steady_clock::now();
+   std::map<point_type, vertex_id> ids;
+   std::vector<region_edge> edges;
+   for(size_t r = 0; r != regions.size(); ++r)
+      add_ring(_graph, ids, regions[r], true, region_id(r), edges);
+   build_memory memory(options.arena);
+   triangle_map<Kernel> triangles(_graph.size(), memory.sets());
+   initial_triangulation(_graph, edges, triangles, memory.arena.get());
+   _triangulation = _graph.edges();
+   _profile.triangulation = seconds_since(start);
+   _top_triangle = refinement(_graph, triangles, options, _profile, memory.arena.get());
+   freeze(options.layout);
+   memory.report(_profile);
 }
 
-void kirkpatrick_type::draw(visualization::drawer_type& drawer) const {
-   drawer.set_color(Qt::blue);
-   for(auto segm: _triangulation) {
-      drawer.draw_line(segm[0], segm[1], 1);
+template<class Kernel>
+basic_kirkpatrick<Kernel>::basic_kirkpatrick(point_arr const& points, point_type const& min,
+      point_type const& max, build_options const& options):
+   _outer_points(find_outer_triangle<Kernel>(point_arr{ min, max })),
+   _graph(_outer_points) {
+   for(auto const& pt: points) {
+      if(pt.x < min.x || pt.y < min.y || max.x < pt.x || max.y < pt.y)
+         throw std::out_of_range("polygon leaves the frame");
    }
-   tr_drawer.draw_inside_triangles(drawer, _top_triangle);
+   KIRKPATRICK_TRACE(info, build) << "polygon of" << points.size() << "vertices in a frame";
+   auto start = std::chrono::steady_clock::now();
+   vertex_arr poly = _graph.add_poly(points);
+   if(!is_counter_clockwise(points))
+      std::reverse(poly.begin(), poly.end());
+   build_memory memory(options.arena);
+   triangle_map<Kernel> triangles(_graph.size(), memory.sets());
+   vertex_arr convex_hull;
+   triangulate_hull(poly, _graph, triangles, options.triangulation, memory.arena.get(),
+         convex_hull);
+   // A small hull is the top level right under the outer triangle. A large
+   // one would make a wide top level, it is tied to its bounding box
+   // instead, one unit wider so that no hull vertex lies on it, and is
+   // refined away. Either way the polygon has nothing outside the box.
+   if(convex_hull.size() - 1 <= MAX_TOP_HULL) {
+      for(auto v: convex_hull) _graph.keep(v);
+   } else {
+      point_type lo = points[0], hi = points[0];
+      for(auto const& pt: points) {
+         lo = point_type(std::min(lo.x, pt.x), std::min(lo.y, pt.y));
+         hi = point_type(std::max(hi.x, pt.x), std::max(hi.y, pt.y));
+      }
+      lo = point_type(lo.x - 1, lo.y - 1);
+      hi = point_type(hi.x + 1, hi.y + 1);
+      // Counter-clockwise from the lower left, the leftmost hull vertex
+      // sees the left side.
+      vertex_arr const box = { _graph.add(lo), _graph.add(point_type(hi.x, lo.y)),
+                               _graph.add(hi), _graph.add(point_type(lo.x, hi.y)) };
+      triangles.resize(_graph.size());
+      for(auto v: box) _graph.keep(v);
+      triangulate_with_outer_ring(convex_hull, box, _graph, triangles, memory.arena.get());
+   }
+   _triangulation = _graph.edges();
+   _profile.triangulation = seconds_since(start);
+   refinement(_graph, triangles, options, _profile, memory.arena.get());
+   _top_triangle = frame_top(_graph, triangles, _outer_points, memory.arena.get());
+   freeze(options.layout);
+   memory.report(_profile);
+}
+
+template<class Kernel>
+void basic_kirkpatrick<Kernel>::freeze(node_layout layout) {
+   auto start = std::chrono::steady_clock::now();
+   _dag = flat_dag_type(_top_triangle, layout);
+   _profile.freeze = seconds_since(start);
+   KIRKPATRICK_TRACE(info, build) << "flat DAG of" << _dag.size() << "triangles";
 }
 
+template<class Kernel>
+bool basic_kirkpatrick<Kernel>::query(point_type const& pt) const {
+   return _dag.query(pt);
+}
+
+template<class Kernel>
+region_id basic_kirkpatrick<Kernel>::locate(point_type const& pt) const {
+   return _dag.locate(pt);
+}
 
+#define INSTANTIATE(K) template struct basic_kirkpatrick<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -1,28 +1,98 @@
 #pragma once
-#pragma comment( lib, "OpenGL32.lib" )
 #include "graph.h"
 #include "util.h"
 #include "triangle.h"
+#include "flat_dag.h"
 #include <memory>
+#include <string>
 #include <vector>
 
-namespace visualization {
-    struct drawer_type;
-}
+enum class triangulation_method {
+   ear_clipping,             // every ear candidate is checked against all vertices
+   grid_ear_clipping         // same triangulation, candidates come from a point grid
+};
 
-using visualization::drawer_type;
+struct build_options {
+   triangulation_method triangulation = triangulation_method::grid_ear_clipping;
+   // Threads that retriangulate the holes of one refinement level,
+   // 0 means one per core.
+   size_t threads = 1;
+   // Triangles and their children lists come from a few large blocks,
+   // freed at once with the last of them. The per-vertex sets of the build
+   // get blocks of their own, freed when the build is done.
+   bool arena = true;
+   // Vertices taken out per refinement level: the order they are tried in,
+   // their largest degree, at least 6, and at most which share of the
+   // vertices left. Low degrees make fewer children per triangle, large
+   // sets fewer levels. Throws std::invalid_argument if out of range.
+   independent_set_method independent_set = independent_set_method::min_degree;
+   size_t max_degree = 8;
+   double removal_fraction = 1;
+   uint64_t seed = 1;                         // of the randomized order
+   // Order of the nodes of the flat DAG, see node_layout. Answers are the
+   // same in all of them.
+   node_layout layout = node_layout::van_emde_boas;
+};
 
-struct triangle_type;
+// Once constructed the structure is immutable: query() and query_batch()
+// may be called from any number of threads (see basic_query_engine).
+// Kernel picks the coordinate type and the predicates, see kernel.h.
+template<class Kernel>
+struct basic_kirkpatrick {
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   typedef typename Kernel::segment_arr segment_arr;
+   typedef basic_triangle_ptr<Kernel> triangle_ptr;
+   typedef basic_flat_dag<Kernel> flat_dag_type;
 
-struct kirkpatrick_type {
-   kirkpatrick_type(point_arr const&);
+   // One simple polygon, its inside is region 0.
+   basic_kirkpatrick(point_arr const&, build_options const& = build_options());
+   // A polygon with holes, the inside of outer minus the insides of holes
+   // is region 0. Holes lie inside outer and may touch it and each other.
+   basic_kirkpatrick(point_arr const& outer, std::vector<point_arr> const& holes,
+         build_options const& = build_options());
+   // A planar subdivision: region i is the inside of regions[i]. The
+   // boundaries are simple polygons of any orientation, they may share
+   // edges and vertices, and a region nested in another one is cut out of
+   // it. Throws std::invalid_argument if boundaries cross or regions overlap.
+   basic_kirkpatrick(std::vector<point_arr> const& regions,
+         build_options const& = build_options());
+   // One simple polygon inside the box [min, max], under the outer triangle
+   // of the box instead of one fitted to the polygon, so that all polygons
+   // of a box share it (see basic_polygon_atlas). A convex hull of up to 16
+   // vertices is the top level right under it, a larger one is refined
+   // inside its bounding box, which is the top level then. Either way
+   // points outside are rejected at the top. Throws std::out_of_range if
+   // the polygon leaves the box.
+   basic_kirkpatrick(point_arr const& polygon, point_type const& min, point_type const& max,
+         build_options const& = build_options());
    bool query(point_type const&) const;
-   void draw(drawer_type& drawer) const;
-   void draw_triangles(drawer_type& drawer) const;
+   // Region containing the point, no_region outside of all of them. A point
+   // on a boundary gets one of the regions it touches.
+   region_id locate(point_type const&) const;
+   void query_batch(point_type const* pts, size_t count, uint8_t* out) const {
+      _dag.query_batch(pts, count, out);
+   }
+   void locate_batch(point_type const* pts, size_t count, region_id* out) const {
+      _dag.locate_batch(pts, count, out);
+   }
+   flat_dag_type const& dag() const { return _dag; }
+   // Time spent in each phase of the build and the levels it made.
+   build_profile const& profile() const { return _profile; }
+   // Stores the hierarchy, basic_flat_dag::load() answers the same queries
+   // from the file without rebuilding.
+   void save(std::string const& path) const { _dag.save(path); }
+   segment_arr const& triangulation() const { return _triangulation; }     // initial one
+   triangle_ptr const& top_triangle() const { return _top_triangle; }
+private:
+   void freeze(node_layout layout);
 private:
    point_arr _outer_points;
-   graph_type _graph;
-   triangle_drawer tr_drawer;
-   std::shared_ptr<triangle_type> _top_triangle;
-   std::vector<segment_type> _triangulation;
+   basic_graph<Kernel> _graph;
+   triangle_ptr _top_triangle;
+   flat_dag_type _dag;
+   segment_arr _triangulation;
+   build_profile _profile;
 };
+
+typedef basic_kirkpatrick<default_kernel> kirkpatrick_type;
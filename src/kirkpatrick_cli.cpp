@@ -0,0 +1,441 @@
+// Command line front end: builds (or maps) the hierarchy for one polygon and
+// answers a stream of query points, one "0" or "1" line per point. With
+// --region it builds a subdivision and prints region ids instead.
+//
+//    kirkpatrick_cli [options] POLYGON [QUERIES]
+//    kirkpatrick_cli [options] --region FILE [--region FILE...] [QUERIES]
+//    kirkpatrick_cli [options] --dag FILE [QUERIES]
+//    kirkpatrick_cli [options] --serve SOCKET POLYGON | --region FILE... | --dag FILE
+//
+// POLYGON, holes and regions are in the viewer's format (see file_test).
+// Query points are read from QUERIES or stdin as pairs of integers, any
+// other characters separate them, so both "x y" and "(x, y)" lines work.
+// A number outside the int32 range ends the run with an error naming its
+// line, the points before it are answered.
+// With --serve the structure answers the binary requests of protocol.h
+// instead, on a Unix domain socket or, for SOCKET "-", on stdin and stdout.
+// Reloads rebuild from the same files, or load one named by --allow-reload.
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "kirkpatrick.h"
+#include "query_engine.h"
+#include "trace.h"
+#ifndef _WIN32
+#include "query_server.h"
+#endif
+
+namespace {
+
+void usage() {
+   std::fprintf(stderr,
+         "usage: kirkpatrick_cli [options] POLYGON [QUERIES]\n"
+         "       kirkpatrick_cli [options] --region FILE [--region FILE...] [QUERIES]\n"
+         "       kirkpatrick_cli [options] --dag FILE [QUERIES]\n"
+         "       kirkpatrick_cli [options] --serve SOCKET POLYGON|--region FILE...|--dag FILE\n"
+         "options:\n"
+         "   --hole FILE   cut a hole into POLYGON, may be repeated\n"
+         "   --region FILE add a region, their ids count from 0 in the given order\n"
+         "   --ids         print region ids, -1 outside, instead of 0/1\n"
+         "   --threads N   build and query threads, 0 means one per core (default 1)\n"
+         "   --iset METHOD vertices removed per level: scan, min-degree (default) or random\n"
+         "   --max-degree N  largest degree of a removed vertex, at least 6 (default 8)\n"
+         "   --removal F   remove at most this share of the vertices per level (default 1)\n"
+         "   --seed N      of --iset random (default 1)\n"
+         "   --layout L    node order of the hierarchy: dfs, bfs or veb (default)\n"
+         "   --save FILE   store the built hierarchy for later --dag runs\n"
+         "   --dag FILE    map a stored hierarchy instead of building one\n"
+         "   --serve PATH  answer binary requests on a Unix socket, - for stdin/stdout;\n"
+         "                 reloads rebuild from the same files\n"
+         "   --allow-reload FILE  a polygon or stored hierarchy reloads may name instead,\n"
+         "                 may be repeated\n"
+         "   --stats       report build phases, hierarchy shape and query work on stderr\n"
+         "   --trace LEVEL trace on stderr: info, debug or verbose, as far as compiled in\n");
+}
+
+point_arr read_polygon(std::string const& path) {
+   std::ifstream ifs(path.c_str());
+   if(!ifs)
+      throw std::runtime_error("cannot open " + path);
+   // The viewer's "polygon complete" flag, the polygon is closed either way.
+   bool complete = false;
+   ifs >> complete;
+   point_arr res((std::istream_iterator<point_type>(ifs)), std::istream_iterator<point_type>());
+   if(res.size() < 3)
+      throw std::runtime_error(path + " holds less than three points");
+   return res;
+}
+
+void print_profile(build_profile const& profile) {
+   std::fprintf(stderr, "triangulation %.3f ms\n", profile.triangulation * 1e3);
+   for(size_t i = 0; i != profile.levels.size(); ++i) {
+      auto const& l = profile.levels[i];
+      std::fprintf(stderr, "level %zu: %zu of %zu vertices removed, %.3f ms\n", i + 1,
+            l.removed, l.vertices, l.seconds * 1e3);
+   }
+   std::fprintf(stderr, "freeze %.3f ms\n", profile.freeze * 1e3);
+   if(profile.arena_bytes)
+      std::fprintf(stderr, "arena %zu KB, scratch %zu KB\n", profile.arena_bytes >> 10,
+            profile.scratch_bytes >> 10);
+}
+
+void print_shape(dag_shape const& shape, node_layout layout) {
+   std::fprintf(stderr, "%zu triangles, %zu leaves, depth %zu, %.2f children per inner node, "
+         "%s layout\nfan-out:", shape.triangles, shape.leaves, shape.depth,
+         shape.mean_fan_out(), to_string(layout));
+   for(size_t k = 0; k != shape.fan_out.size(); ++k) {
+      if(shape.fan_out[k]) std::fprintf(stderr, " %zu:%zu", k, shape.fan_out[k]);
+   }
+   std::fprintf(stderr, "\n");
+}
+
+// Files the structure is made of, kept to make it again on a reload.
+struct sources {
+   std::string polygon, dag;
+   std::vector<std::string> holes, regions;
+   std::vector<std::string> reloads;        // canonical paths reloads may name
+};
+
+bool is_dag_file(std::string const& path) {
+   std::ifstream ifs(path.c_str(), std::ios::binary);
+   char magic[8] = { 0 };
+   ifs.read(magic, sizeof(magic));
+   return ifs && std::memcmp(magic, "KIRKDAG", sizeof(magic)) == 0;
+}
+
+flat_dag_type make_dag(sources const& src, build_options const& options, bool stats) {
+   if(!src.dag.empty()) return flat_dag_type::load(src.dag);
+   std::unique_ptr<kirkpatrick_type> built;
+   if(!src.regions.empty()) {
+      std::vector<point_arr> regions;
+      for(auto const& path: src.regions) regions.push_back(read_polygon(path));
+      built.reset(new kirkpatrick_type(regions, options));
+   } else {
+      std::vector<point_arr> holes;
+      for(auto const& path: src.holes) holes.push_back(read_polygon(path));
+      point_arr const polygon = read_polygon(src.polygon);
+      built.reset(holes.empty() ? new kirkpatrick_type(polygon, options)
+                                : new kirkpatrick_type(polygon, holes, options));
+   }
+   if(stats) print_profile(built->profile());
+   return built->dag();
+}
+
+#ifndef _WIN32
+std::atomic<query_server*> serving{nullptr};
+
+void stop_serving(int) {
+   if(query_server* server = serving.load()) server->stop();
+}
+
+// Serves dag until the input ends (stdin) or SIGINT or SIGTERM (socket).
+void serve(std::string const& path, flat_dag_type const& dag, sources const& src,
+      build_options const& options, bool stats) {
+   std::signal(SIGPIPE, SIG_IGN);            // clients may hang up at any time
+   // Clients only pick among the files given on the command line.
+   query_server server(dag, [&](std::string const& file) {
+      if(file.empty()) return make_dag(src, options, stats);
+      char* resolved = realpath(file.c_str(), nullptr);
+      std::string const canonical = resolved ? resolved : "";
+      std::free(resolved);
+      if(canonical.empty() ||
+            std::find(src.reloads.begin(), src.reloads.end(), canonical) == src.reloads.end())
+         throw std::runtime_error("reloading " + file + " is not allowed");
+      sources other;
+      (is_dag_file(canonical) ? other.dag : other.polygon) = canonical;
+      return make_dag(other, options, stats);
+   });
+   if(path == "-") {
+      server.serve(0, 1);
+   } else {
+      serving = &server;
+      std::signal(SIGINT, stop_serving);
+      std::signal(SIGTERM, stop_serving);
+      server.listen(path);
+      serving = nullptr;
+   }
+   if(stats) {
+      server_counters const c = server.counters();
+      std::fprintf(stderr, "%llu connections, %llu requests, %llu points, %llu reloads, "
+            "%llu errors\n", (unsigned long long)c.connections, (unsigned long long)c.requests,
+            (unsigned long long)c.points, (unsigned long long)c.reloads,
+            (unsigned long long)c.errors);
+   }
+}
+#endif
+
+// Sums of the per-query counters, for the averages and the worst case.
+struct query_totals {
+   size_t queries = 0;
+   size_t tested = 0, max_tested = 0;
+   size_t orientations = 0, max_orientations = 0;
+   size_t depth = 0, max_depth = 0;
+   size_t branched = 0;          // queries that went into several children
+
+   void add(query_stats const& st) {
+      ++queries;
+      tested += st.triangles_tested;
+      max_tested = std::max(max_tested, st.triangles_tested);
+      orientations += st.orientations;
+      max_orientations = std::max(max_orientations, st.orientations);
+      depth += st.depth;
+      max_depth = std::max(max_depth, st.depth);
+      branched += st.branches != 0;
+   }
+
+   void print() const {
+      if(!queries) return;
+      std::fprintf(stderr, "%zu queries: %.1f triangles tested (max %zu), %.1f orientations "
+            "(max %zu), depth %.1f (max %zu), %zu on shared edges\n", queries,
+            double(tested) / queries, max_tested, double(orientations) / queries,
+            max_orientations, double(depth) / queries, max_depth, branched);
+   }
+};
+
+// Pulls integer pairs out of a stream in fixed size blocks.
+struct point_reader {
+   explicit point_reader(std::FILE* in): _in(in), _buffer(1 << 20) { }
+
+   // Appends up to max points to pts, returns false at the end of the input
+   // or at a number that is no coordinate, see error().
+   bool read(point_arr& pts, size_t max) {
+      while(pts.size() < max) {
+         if(_pos == _end && !fill()) return false;
+         char const c = _buffer[_pos];
+         if(c == '-' || (c >= '0' && c <= '9')) {
+            size_t start = _pos;
+            // Numbers may cross block boundaries, keep them whole.
+            while(!number_complete(start)) {
+               bool more = fill(start);
+               start = 0;
+               if(!more) break;
+            }
+            int32_t value;
+            bool valid = true;
+            if(!parse(start, value, valid)) continue;       // a lone '-'
+            if(!valid) {
+               _error = "line " + std::to_string(_line) + ": coordinate out of range";
+               _eof = true;
+               return false;
+            }
+            if(_have_x) {
+               pts.push_back(point_type(_x, value));
+               _have_x = false;
+            } else {
+               _x = value;
+               _have_x = true;
+            }
+         } else {
+            _line += c == '\n';
+            ++_pos;
+         }
+      }
+      return true;
+   }
+   // Why read() stopped early, empty if it did not.
+   std::string const& error() const { return _error; }
+private:
+   bool is_digit(char c) const { return c >= '0' && c <= '9'; }
+
+   bool number_complete(size_t start) {
+      size_t i = start + (_buffer[start] == '-');
+      while(i != _end && is_digit(_buffer[i])) ++i;
+      return i != _end || _eof;
+   }
+
+   // valid is cleared if the number does not fit into an int32_t.
+   bool parse(size_t start, int32_t& res, bool& valid) {
+      _pos = start;
+      bool negative = _buffer[_pos] == '-';
+      if(negative) ++_pos;
+      size_t const digits = _pos;
+      int64_t const limit = negative ? -int64_t(std::numeric_limits<int32_t>::min())
+                                     : std::numeric_limits<int32_t>::max();
+      int64_t value = 0;
+      while(_pos != _end && is_digit(_buffer[_pos])) {
+         value = value * 10 + (_buffer[_pos++] - '0');
+         if(value > limit) {
+            valid = false;
+            value = 0;                            // skips the other digits
+            while(_pos != _end && is_digit(_buffer[_pos])) ++_pos;
+         }
+      }
+      res = int32_t(negative ? -value : value);
+      return _pos != digits;
+   }
+
+   // Moves [keep, _end) to the front and reads more behind it.
+   bool fill(size_t keep = std::string::npos) {
+      if(_eof) return false;
+      size_t kept = 0;
+      if(keep != std::string::npos) {
+         kept = _end - keep;
+         std::memmove(_buffer.data(), _buffer.data() + keep, kept);
+      }
+      size_t n = std::fread(_buffer.data() + kept, 1, _buffer.size() - kept, _in);
+      if(n == 0) _eof = true;
+      _pos = 0;
+      _end = kept + n;
+      return n != 0;
+   }
+private:
+   std::FILE* _in;
+   std::vector<char> _buffer;
+   size_t _pos = 0, _end = 0;
+   bool _eof = false;
+   size_t _line = 1;
+   std::string _error;
+   bool _have_x = false;
+   int32_t _x = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+   size_t threads = 1;
+   build_options options;
+   std::string save_path, serve_path;
+   sources src;
+   std::vector<std::string> args;
+   bool ids = false, stats = false;
+   for(int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+      if(arg == "--threads" && has_value) threads = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--iset" && has_value) {
+         std::string const method = argv[++i];
+         if(method == "scan") options.independent_set = independent_set_method::scan;
+         else if(method == "min-degree") options.independent_set = independent_set_method::min_degree;
+         else if(method == "random") options.independent_set = independent_set_method::randomized;
+         else { usage(); return 2; }
+      }
+      else if(arg == "--max-degree" && has_value)
+         options.max_degree = std::strtoul(argv[++i], nullptr, 10);
+      else if(arg == "--removal" && has_value) options.removal_fraction = std::atof(argv[++i]);
+      else if(arg == "--seed" && has_value) options.seed = std::strtoull(argv[++i], nullptr, 10);
+      else if(arg == "--layout" && has_value) {
+         std::string const layout = argv[++i];
+         if(layout == "dfs") options.layout = node_layout::depth_first;
+         else if(layout == "bfs") options.layout = node_layout::breadth_first;
+         else if(layout == "veb") options.layout = node_layout::van_emde_boas;
+         else { usage(); return 2; }
+      }
+      else if(arg == "--save" && has_value) save_path = argv[++i];
+      else if(arg == "--dag" && has_value) src.dag = argv[++i];
+      else if(arg == "--hole" && has_value) src.holes.push_back(argv[++i]);
+      else if(arg == "--region" && has_value) src.regions.push_back(argv[++i]);
+#ifndef _WIN32
+      else if(arg == "--serve" && has_value) serve_path = argv[++i];
+      else if(arg == "--allow-reload" && has_value) {
+         char* resolved = realpath(argv[++i], nullptr);
+         if(!resolved) {
+            std::fprintf(stderr, "cannot find %s\n", argv[i]);
+            return 2;
+         }
+         src.reloads.push_back(resolved);
+         std::free(resolved);
+      }
+#endif
+      else if(arg == "--ids") ids = true;
+      else if(arg == "--stats") stats = true;
+      else if(arg == "--trace" && has_value) {
+         std::string const level = argv[++i];
+         if(level == "info") set_trace_level(trace_level::info);
+         else if(level == "debug") set_trace_level(trace_level::debug);
+         else if(level == "verbose") set_trace_level(trace_level::verbose);
+         else { usage(); return 2; }
+      }
+      else if(arg == "-h" || arg == "--help") { usage(); return 0; }
+      else if(arg.size() > 1 && arg[0] == '-') { usage(); return 2; }
+      else args.push_back(arg);
+   }
+   if(!src.regions.empty()) ids = true;
+   size_t const inputs = src.dag.empty() && src.regions.empty() ? 1 : 0;
+   size_t const queries = serve_path.empty() ? 1 : 0;
+   if(args.size() < inputs || args.size() > inputs + queries) {
+      usage();
+      return 2;
+   }
+
+   try {
+      options.threads = threads;
+      if(inputs) src.polygon = args[0];
+      flat_dag_type const dag = make_dag(src, options, stats);
+      if(stats) print_shape(dag.shape(), dag.layout());
+      if(!save_path.empty()) dag.save(save_path);
+#ifndef _WIN32
+      if(!serve_path.empty()) {
+         serve(serve_path, dag, src, options, stats);
+         return 0;
+      }
+#endif
+
+      std::FILE* in = stdin;
+      if(args.size() > inputs) {
+         in = std::fopen(args[inputs].c_str(), "rb");
+         if(!in) throw std::runtime_error("cannot open " + args[inputs]);
+      }
+      std::unique_ptr<query_engine_type> engine;
+      if(threads != 1) engine.reset(new query_engine_type(dag, threads));
+
+      size_t const batch = 1 << 16;
+      point_reader reader(in);
+      point_arr pts;
+      std::vector<uint8_t> hits;
+      std::vector<region_id> regions;
+      std::string out;
+      query_totals totals;
+      pts.reserve(batch);
+      for(bool more = true; more;) {
+         pts.clear();
+         more = reader.read(pts, batch);
+         if(ids) {
+            regions.resize(pts.size());
+            if(engine) engine->locate(pts.data(), pts.size(), regions.data());
+            else dag.locate_batch(pts.data(), pts.size(), regions.data());
+            out.clear();
+            for(auto r: regions) {
+               out += std::to_string(r);
+               out += '\n';
+            }
+         } else {
+            hits.resize(pts.size());
+            if(engine) engine->query(pts.data(), pts.size(), hits.data());
+            else dag.query_batch(pts.data(), pts.size(), hits.data());
+            out.resize(2 * hits.size());
+            for(size_t i = 0; i != hits.size(); ++i) {
+               out[2 * i] = hits[i] ? '1' : '0';
+               out[2 * i + 1] = '\n';
+            }
+         }
+         std::fwrite(out.data(), 1, out.size(), stdout);
+         if(stats) {
+            // One more, instrumented descent per point.
+            query_stats st;
+            for(auto const& pt: pts) {
+               dag.locate(pt, st);
+               totals.add(st);
+            }
+         }
+      }
+      if(in != stdin) std::fclose(in);
+      if(!reader.error().empty()) throw std::runtime_error(reader.error());
+      totals.print();
+   } catch(std::exception const& e) {
+      std::fprintf(stderr, "kirkpatrick_cli: %s\n", e.what());
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,124 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(std::string const& path) {
+   _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if(_file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("cannot open " + path);
+   LARGE_INTEGER size;
+   if(!GetFileSizeEx(_file, &size)) {
+      CloseHandle(_file);
+      throw std::runtime_error("cannot stat " + path);
+   }
+   _size = size_t(size.QuadPart);
+   if(_size == 0) return;                    // empty files cannot be mapped
+   _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+   if(_mapping)
+      _data = static_cast<char const*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+   if(!_data) {
+      if(_mapping) CloseHandle(_mapping);
+      CloseHandle(_file);
+      throw std::runtime_error("cannot map " + path);
+   }
+}
+
+mapped_file::~mapped_file() {
+   if(_data) UnmapViewOfFile(_data);
+   if(_mapping) CloseHandle(_mapping);
+   CloseHandle(_file);
+}
+
+void replace_file(std::string const& path, char const* data, size_t size) {
+   std::string const temp = path + ".tmp";
+   HANDLE file = CreateFileA(temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+         FILE_ATTRIBUTE_NORMAL, nullptr);
+   if(file == INVALID_HANDLE_VALUE)
+      throw std::runtime_error("cannot write " + temp);
+   bool ok = true;
+   while(ok && size != 0) {
+      DWORD const chunk = DWORD(std::min<size_t>(size, 1 << 30));
+      DWORD written = 0;
+      ok = WriteFile(file, data, chunk, &written, nullptr) && written != 0;
+      data += written;
+      size -= written;
+   }
+   ok = ok && FlushFileBuffers(file);
+   CloseHandle(file);
+   if(!ok || !MoveFileExA(temp.c_str(), path.c_str(),
+         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+      DeleteFileA(temp.c_str());
+      throw std::runtime_error("cannot write " + path);
+   }
+}
+
+#else
+
+mapped_file::mapped_file(std::string const& path) {
+   int fd = open(path.c_str(), O_RDONLY);
+   if(fd < 0)
+      throw std::runtime_error("cannot open " + path);
+   struct stat st;
+   if(fstat(fd, &st) != 0) {
+      close(fd);
+      throw std::runtime_error("cannot stat " + path);
+   }
+   _size = size_t(st.st_size);
+   if(_size != 0) {                           // empty files cannot be mapped
+      void* p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+      if(p == MAP_FAILED) {
+         close(fd);
+         throw std::runtime_error("cannot map " + path);
+      }
+      _data = static_cast<char const*>(p);
+   }
+   close(fd);                                 // the mapping keeps the file alive
+}
+
+mapped_file::~mapped_file() {
+   if(_data) munmap(const_cast<char*>(_data), _size);
+}
+
+void replace_file(std::string const& path, char const* data, size_t size) {
+   std::string temp = path + ".XXXXXX";
+   int fd = mkstemp(&temp[0]);
+   if(fd < 0)
+      throw std::runtime_error("cannot write " + path);
+   // mkstemp makes it 0600, a replaced file keeps its mode.
+   struct stat st;
+   bool ok = fchmod(fd, stat(path.c_str(), &st) == 0 ? st.st_mode & 07777 : 0644) == 0;
+   while(ok && size != 0) {
+      ssize_t n = write(fd, data, size);
+      if(n < 0 && errno == EINTR) continue;
+      ok = n > 0;
+      if(ok) {
+         data += n;
+         size -= size_t(n);
+      }
+   }
+   ok = ok && fsync(fd) == 0;
+   ok = close(fd) == 0 && ok;
+   if(!ok || rename(temp.c_str(), path.c_str()) != 0) {
+      unlink(temp.c_str());
+      throw std::runtime_error("cannot write " + path);
+   }
+}
+
+#endif
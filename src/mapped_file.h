@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. The pages are shared with the
+// page cache, so processes mapping the same file share one copy.
+struct mapped_file {
+   explicit mapped_file(std::string const& path);    // throws std::runtime_error
+   ~mapped_file();
+   mapped_file(mapped_file const&) = delete;
+   mapped_file& operator=(mapped_file const&) = delete;
+
+   char const* data() const { return _data; }
+   size_t size() const { return _size; }
+private:
+   char const* _data = nullptr;
+   size_t _size = 0;
+#ifdef _WIN32
+   void* _file = nullptr;
+   void* _mapping = nullptr;
+#endif
+};
+
+// Writes size bytes at data to a new file next to path, syncs it and
+// renames it over path. Mappings of the file it replaces keep the old
+// contents. On Windows a file that is still mapped cannot be replaced,
+// it throws then. Throws std::runtime_error on I/O errors, path is left
+// as it was.
+void replace_file(std::string const& path, char const* data, size_t size);
@@ -0,0 +1,69 @@
+#include "point_grid.h"
+
+#include <cmath>
+
+template<class Kernel>
+basic_point_grid<Kernel>::basic_point_grid(point_arr const& points) {
+   if(points.empty()) {
+      _offsets.assign(2, 0);
+      return;
+   }
+   double max_x = double(points[0].x), max_y = double(points[0].y);
+   _min_x = max_x;
+   _min_y = max_y;
+   for(auto const& p: points) {
+      _min_x = std::min(_min_x, double(p.x)); max_x = std::max(max_x, double(p.x));
+      _min_y = std::min(_min_y, double(p.y)); max_y = std::max(max_y, double(p.y));
+   }
+   double w = max_x - _min_x + 1, h = max_y - _min_y + 1;
+   // Square cells, as many as there are points.
+   double side = std::max(1.0, std::sqrt(w * h / points.size()));
+   _cell_w = _cell_h = std::ceil(side);
+   _columns = size_t(std::ceil(w / _cell_w));
+   _rows = size_t(std::ceil(h / _cell_h));
+
+   // Counting sort of the points by cell.
+   std::vector<uint32_t> count(_columns * _rows + 1, 0);
+   for(auto const& p: points) ++count[row(p.y) * _columns + column(p.x) + 1];
+   for(size_t c = 1; c != count.size(); ++c) count[c] += count[c - 1];
+   _offsets = count;
+   _points.resize(points.size());
+   for(auto const& p: points) _points[count[row(p.y) * _columns + column(p.x)]++] = p;
+}
+
+template<class Kernel>
+size_t basic_point_grid<Kernel>::column(coord_type x) const {
+   double c = std::floor((double(x) - _min_x) / _cell_w);
+   if(!(c > 0)) return 0;
+   return std::min(_columns - 1, size_t(std::min(c, double(_columns))));
+}
+
+template<class Kernel>
+size_t basic_point_grid<Kernel>::row(coord_type y) const {
+   double r = std::floor((double(y) - _min_y) / _cell_h);
+   if(!(r > 0)) return 0;
+   return std::min(_rows - 1, size_t(std::min(r, double(_rows))));
+}
+
+template<class Kernel>
+bool basic_point_grid<Kernel>::any_inside(point_type const& p1, point_type const& p2,
+      point_type const& p3) const {
+   size_t c0 = column(std::min({ p1.x, p2.x, p3.x }));
+   size_t c1 = column(std::max({ p1.x, p2.x, p3.x }));
+   size_t r0 = row(std::min({ p1.y, p2.y, p3.y }));
+   size_t r1 = row(std::max({ p1.y, p2.y, p3.y }));
+   for(size_t r = r0; r <= r1; ++r) {
+      for(size_t c = c0; c <= c1; ++c) {
+         size_t cell = r * _columns + c;
+         for(uint32_t i = _offsets[cell]; i != _offsets[cell + 1]; ++i) {
+            point_type const& pt = _points[i];
+            if(pt == p1 || pt == p2 || pt == p3) continue;
+            if(inside_triangle(p1, p2, p3, pt)) return true;
+         }
+      }
+   }
+   return false;
+}
+
+#define INSTANTIATE(K) template struct basic_point_grid<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "util.h"
+
+// Uniform bucket grid over a fixed set of points, about one point per cell.
+// Answers the containment scans of the ear clipping without walking the
+// whole polygon: only the cells under the triangle's bounding box are looked at.
+// Cells are found in double arithmetic, which is monotone in the coordinates
+// of every kernel, so no point under the box is missed.
+template<class Kernel>
+struct basic_point_grid {
+   typedef typename Kernel::point_type point_type;
+   typedef typename Kernel::point_arr point_arr;
+   typedef typename Kernel::coord_type coord_type;
+
+   explicit basic_point_grid(point_arr const& points);
+   // Same as checking inside_triangle(p1, p2, p3, pt) for every point
+   // other than p1, p2 and p3 themselves.
+   bool any_inside(point_type const& p1, point_type const& p2,
+         point_type const& p3) const;
+private:
+   size_t column(coord_type x) const;
+   size_t row(coord_type y) const;
+private:
+   double _min_x = 0, _min_y = 0;
+   double _cell_w = 1, _cell_h = 1;
+   size_t _columns = 1, _rows = 1;
+   std::vector<uint32_t> _offsets;       // cell c holds _points[_offsets[c] .. _offsets[c + 1])
+   point_arr _points;
+};
+
+typedef basic_point_grid<default_kernel> point_grid;
+
+// Ear test backed by a grid over the polygon's points, equivalent to is_ear.
+template<class Kernel>
+bool is_ear(typename Kernel::point_type const& p1, typename Kernel::point_type const& p2,
+      typename Kernel::point_type const& p3, basic_point_grid<Kernel> const& grid) {
+   return is_left_turn(p1, p2, p3) && !grid.any_inside(p1, p2, p3);
+}
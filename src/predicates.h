@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Exact orientation of three points: 1 if a, b, c make a left turn,
+// -1 for a right turn and 0 if they are collinear, i.e. the sign of
+// (b - a) x (c - a). One overload per coordinate type of kernel.h.
+
+namespace predicates {
+
+template<class T>
+int sign_of(T t) { return (t > 0) - (t < 0); }
+
+// Error-free transformations, a + b = x + y and a * b = x + y exactly.
+inline void two_sum(double a, double b, double& x, double& y) {
+   x = a + b;
+   double bv = x - a;
+   double av = x - bv;
+   y = (a - av) + (b - bv);
+}
+
+inline void two_product(double a, double b, double& x, double& y) {
+   x = a * b;
+   y = std::fma(a, b, -x);
+}
+
+// Sign of ax * by - ay * bx + bx * cy - by * cx + cx * ay - cy * ax, summed
+// exactly as a nonoverlapping expansion (Shewchuk's Grow-Expansion with
+// zero elimination). Its largest component carries the sign.
+inline int orientation_exact(double ax, double ay, double bx, double by,
+      double cx, double cy) {
+   double const products[6][2] = { { ax, by }, { -ay, bx }, { bx, cy },
+                                   { -by, cx }, { cx, ay }, { -cy, ax } };
+   double e[12];
+   int n = 0;
+   auto grow = [&](double b) {
+      int m = 0;
+      for(int i = 0; i != n; ++i) {
+         double h;
+         two_sum(b, e[i], b, h);
+         if(h != 0) e[m++] = h;
+      }
+      if(b != 0) e[m++] = b;
+      n = m;
+   };
+   for(auto const& p: products) {
+      double x, y;
+      two_product(p[0], p[1], x, y);
+      grow(y);
+      grow(x);
+   }
+   return n == 0 ? 0 : sign_of(e[n - 1]);
+}
+
+// Floating-point filter of Shewchuk's orient2d, the exact sum is only
+// computed when the rounded determinant is too close to zero to trust.
+inline int orientation(double ax, double ay, double bx, double by, double cx, double cy) {
+   double const eps = std::numeric_limits<double>::epsilon() / 2;
+   double const bound = (3 + 16 * eps) * eps;
+   double const left = (ax - cx) * (by - cy);
+   double const right = (ay - cy) * (bx - cx);
+   double const det = left - right;
+   double sum;
+   if(left > 0) {
+      if(right <= 0) return sign_of(det);
+      sum = left + right;
+   } else if(left < 0) {
+      if(right >= 0) return sign_of(det);
+      sum = -left - right;
+   } else {
+      return sign_of(det);
+   }
+   if(std::fabs(det) >= bound * sum) return sign_of(det);
+   return orientation_exact(ax, ay, bx, by, cx, cy);
+}
+
+// 32-bit coordinates: the differences take 33 bits and their products 65,
+// so int64 is exact as long as the points span less than 2^31 per axis.
+inline int orientation(int32_t ax, int32_t ay, int32_t bx, int32_t by,
+      int32_t cx, int32_t cy) {
+   int64_t const ux = int64_t(bx) - ax, uy = int64_t(by) - ay;
+   int64_t const vx = int64_t(cx) - ax, vy = int64_t(cy) - ay;
+   int64_t const limit = int64_t(1) << 31;
+   if(ux < limit && -ux < limit && uy < limit && -uy < limit &&
+         vx < limit && -vx < limit && vy < limit && -vy < limit)
+      return sign_of(ux * vy - uy * vx);
+#ifdef __SIZEOF_INT128__
+   return sign_of(__int128(ux) * vy - __int128(uy) * vx);
+#else
+   return orientation_exact(ax, ay, bx, by, cx, cy);     // int32 converts exactly
+#endif
+}
+
+#ifdef __SIZEOF_INT128__
+// a * b as hi * 2^32 + lo with lo < 2^32, for a, b < 2^65.
+inline void wide_product(unsigned __int128 a, unsigned __int128 b,
+      unsigned __int128& hi, unsigned __int128& lo) {
+   unsigned __int128 const mask = 0xffffffffu;
+   hi = (a >> 32) * b;
+   lo = (a & mask) * b;
+   hi += lo >> 32;
+   lo &= mask;
+}
+
+// Sign of a * b - c * d for |a|, |b|, |c|, |d| < 2^65.
+inline int sign_of_difference(__int128 a, __int128 b, __int128 c, __int128 d) {
+   int const s1 = sign_of(a) * sign_of(b), s2 = sign_of(c) * sign_of(d);
+   if(s1 != s2) return s1 > s2 ? 1 : -1;
+   if(s1 == 0) return 0;
+   auto magnitude = [](__int128 v) { return (unsigned __int128)(v < 0 ? -v : v); };
+   unsigned __int128 h1, l1, h2, l2;
+   wide_product(magnitude(a), magnitude(b), h1, l1);
+   wide_product(magnitude(c), magnitude(d), h2, l2);
+   if(h1 == h2 && l1 == l2) return 0;
+   bool const larger = h1 != h2 ? h1 > h2 : l1 > l2;
+   return larger ? s1 : -s1;
+}
+#endif
+
+inline int orientation(int64_t ax, int64_t ay, int64_t bx, int64_t by,
+      int64_t cx, int64_t cy) {
+#ifdef __SIZEOF_INT128__
+   __int128 const ux = __int128(bx) - ax, uy = __int128(by) - ay;
+   __int128 const vx = __int128(cx) - ax, vy = __int128(cy) - ay;
+   // Differences take 65 bits, their products only fit below 2^62.
+   __int128 const limit = __int128(1) << 62;
+   if(ux < limit && -ux < limit && uy < limit && -uy < limit &&
+         vx < limit && -vx < limit && vy < limit && -vy < limit)
+      return sign_of(ux * vy - uy * vx);
+   return sign_of_difference(ux, vy, uy, vx);
+#else
+   // Only exact while the coordinates fit in the 53 bits of a double.
+   return orientation_exact(double(ax), double(ay), double(bx), double(by),
+         double(cx), double(cy));
+#endif
+}
+
+inline int orientation(float ax, float ay, float bx, float by, float cx, float cy) {
+   return orientation(double(ax), double(ay), double(bx), double(by), double(cx), double(cy));
+}
+
+// Rounded versions for fast_predicates. The int32 one is exact as long as
+// the points span less than 2^31 per axis.
+inline int fast_orientation(int32_t ax, int32_t ay, int32_t bx, int32_t by,
+      int32_t cx, int32_t cy) {
+   int64_t const ux = int64_t(bx) - ax, uy = int64_t(by) - ay;
+   int64_t const vx = int64_t(cx) - ax, vy = int64_t(cy) - ay;
+   return sign_of(ux * vy - uy * vx);
+}
+
+inline int fast_orientation(int64_t ax, int64_t ay, int64_t bx, int64_t by,
+      int64_t cx, int64_t cy) {
+   double const ux = double(bx) - double(ax), uy = double(by) - double(ay);
+   double const vx = double(cx) - double(ax), vy = double(cy) - double(ay);
+   return sign_of(ux * vy - uy * vx);
+}
+
+template<class T>
+int fast_orientation(T ax, T ay, T bx, T by, T cx, T cy) {
+   return sign_of((bx - ax) * (cy - ay) - (by - ay) * (cx - ax));
+}
+
+} // namespace predicates
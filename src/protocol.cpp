@@ -0,0 +1,50 @@
+#include "protocol.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+size_t item_bytes(frame_type type) {
+   switch(type) {
+   case frame_type::query:
+   case frame_type::locate: return 2 * sizeof(int32_t);
+   case frame_type::regions: return sizeof(int32_t);
+   case frame_type::hits:
+   case frame_type::reload:
+   case frame_type::error:
+   case frame_type::reloaded: return 1;
+   }
+   return 0;
+}
+
+bool read_full(int fd, void* data, size_t bytes) {
+   char* p = static_cast<char*>(data);
+   size_t done = 0;
+   while(done != bytes) {
+      ssize_t n = read(fd, p + done, bytes - done);
+      if(n < 0 && errno == EINTR) continue;
+      if(n < 0)
+         throw std::runtime_error(std::string("read failed: ") + std::strerror(errno));
+      if(n == 0) {
+         if(done == 0) return false;
+         throw std::runtime_error("input ends within a frame");
+      }
+      done += size_t(n);
+   }
+   return true;
+}
+
+void write_full(int fd, void const* data, size_t bytes) {
+   char const* p = static_cast<char const*>(data);
+   while(bytes) {
+      ssize_t n = write(fd, p, bytes);
+      if(n < 0 && errno == EINTR) continue;
+      if(n < 0)
+         throw std::runtime_error(std::string("write failed: ") + std::strerror(errno));
+      p += n;
+      bytes -= size_t(n);
+   }
+}
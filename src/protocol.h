@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary framing of the query server (query_server.h). A frame is a
+// frame_header and count items of payload, everything native-endian like
+// the DAG images: server and clients run on the same machine.
+//
+//    request                                  response
+//    query    count points, two int32 each    hits      count bytes, 0 or 1
+//    locate   count points                    regions   count int32 region ids
+//    reload   count bytes of a path, or none  reloaded  no payload
+//                                             error     count bytes of text
+//
+// Responses come in the order of the requests and echo their tags, so a
+// client may send further requests before reading the first answer. It
+// has to read while it sends though, the server stops reading while its
+// answers are not taken. generation numbers the structure that answered,
+// every reload adds one.
+enum class frame_type : uint32_t {
+   query = 1, locate, reload,
+   hits = 0x81, regions, reloaded, error
+};
+
+struct frame_header {
+   frame_type type;
+   uint32_t tag;                 // chosen by the client
+   uint32_t count;               // items of payload
+   uint32_t generation;          // 0 in requests
+};
+
+// Larger requests are answered with an error and end the connection.
+const uint32_t max_frame_items = 1 << 22;
+
+// Bytes of one payload item, 0 for unknown types.
+size_t item_bytes(frame_type);
+
+// Blocking I/O on a socket or pipe, restarted after signals. Both throw
+// std::runtime_error on errors. read_full() returns false if the input
+// ends before the first byte and throws if it ends later.
+bool read_full(int fd, void* data, size_t bytes);
+void write_full(int fd, void const* data, size_t bytes);
@@ -0,0 +1,45 @@
+#include "query_engine.h"
+
+#include <algorithm>
+#include <chrono>
+
+template<class Kernel>
+basic_query_engine<Kernel>::basic_query_engine(basic_flat_dag<Kernel> const& dag, size_t threads,
+      size_t chunk_size):
+   _dag(dag), _pool(threads), _chunk_size(std::max<size_t>(chunk_size, 1)),
+   _stats(_pool.size()) { }
+
+template<class Kernel>
+template<class Batch>
+void basic_query_engine<Kernel>::run(size_t count, Batch const& batch) {
+   size_t const chunks = (count + _chunk_size - 1) / _chunk_size;
+   _pool.run(chunks, [&](size_t chunk, size_t worker) {
+      auto start = std::chrono::steady_clock::now();
+      size_t first = chunk * _chunk_size;
+      size_t n = std::min(_chunk_size, count - first);
+      batch(first, n);
+      worker_stats& st = _stats[worker];
+      st.points += n;
+      st.chunks += 1;
+      st.seconds += std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+   });
+}
+
+template<class Kernel>
+void basic_query_engine<Kernel>::query(point_type const* pts, size_t count, uint8_t* out) {
+   run(count, [&](size_t first, size_t n) { _dag.query_batch(pts + first, n, out + first); });
+}
+
+template<class Kernel>
+void basic_query_engine<Kernel>::locate(point_type const* pts, size_t count, region_id* out) {
+   run(count, [&](size_t first, size_t n) { _dag.locate_batch(pts + first, n, out + first); });
+}
+
+template<class Kernel>
+void basic_query_engine<Kernel>::reset_stats() {
+   std::fill(_stats.begin(), _stats.end(), worker_stats());
+}
+
+#define INSTANTIATE(K) template struct basic_query_engine<K>;
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "flat_dag.h"
+#include "thread_pool.h"
+
+// Per-worker counters. Each worker only writes its own entry, the entries
+// are padded to separate cache lines.
+struct alignas(64) worker_stats {
+   size_t points = 0;
+   size_t chunks = 0;
+   double seconds = 0;            // time spent answering queries
+   double throughput() const { return seconds > 0 ? points / seconds : 0; }
+};
+
+// Answers large point batches on a work-stealing pool. The flat DAG is
+// never written after construction, so any number of workers may walk it
+// at once; the engine only has to keep the output ranges disjoint.
+template<class Kernel>
+struct basic_query_engine {
+   typedef typename Kernel::point_type point_type;
+
+   explicit basic_query_engine(basic_flat_dag<Kernel> const& dag, size_t threads = 0,
+         size_t chunk_size = 16384);
+   // out[i] = dag.query(pts[i])
+   void query(point_type const* pts, size_t count, uint8_t* out);
+   // out[i] = dag.locate(pts[i])
+   void locate(point_type const* pts, size_t count, region_id* out);
+   size_t threads() const { return _pool.size(); }
+   std::vector<worker_stats> const& stats() const { return _stats; }
+   void reset_stats();
+private:
+   // Runs batch(first, n) over the chunks of [0, count).
+   template<class Batch>
+   void run(size_t count, Batch const& batch);
+   basic_flat_dag<Kernel> const& _dag;
+   work_stealing_pool _pool;
+   size_t _chunk_size;
+   std::vector<worker_stats> _stats;
+};
+
+typedef basic_query_engine<default_kernel> query_engine_type;
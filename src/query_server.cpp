@@ -0,0 +1,271 @@
+#include "query_server.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace {
+
+static_assert(sizeof(flat_dag_type::point_type) == 2 * sizeof(int32_t),
+      "query points are sent as two int32 each");
+
+bool is_request(frame_type type) {
+   return type == frame_type::query || type == frame_type::locate ||
+         type == frame_type::reload;
+}
+
+std::runtime_error system_error(std::string const& what) {
+   return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+// Buffers of one connection, reused from request to request.
+struct query_server::session {
+   std::vector<char> input = std::vector<char>(1 << 16);
+   std::vector<char> output;
+   point_arr points;
+   std::vector<region_id> regions;
+};
+
+// The thread closes fd as soon as serve() returns, so that the client sees
+// the end of a connection the server ended. mutex keeps reap() from
+// shutting down a descriptor that was closed and reused meanwhile.
+struct query_server::connection {
+   std::mutex mutex;
+   int fd;                                    // -1 once closed
+   std::thread thread;
+   std::atomic<bool> done{false};
+};
+
+query_server::query_server(flat_dag_type const& dag, loader_type loader):
+   _loader(std::move(loader)),
+   _current(std::make_shared<snapshot const>(snapshot{ dag, 1 })) {
+   if(pipe(_wake) != 0)
+      throw system_error("cannot create a pipe");
+}
+
+query_server::~query_server() {
+   reap(true);
+   close(_wake[0]);
+   close(_wake[1]);
+}
+
+std::shared_ptr<query_server::snapshot const> query_server::current() const {
+   std::lock_guard<std::mutex> lock(_mutex);
+   return _current;
+}
+
+uint32_t query_server::publish(flat_dag_type const& dag) {
+   std::shared_ptr<snapshot const> old;
+   uint32_t generation;
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      generation = _current->generation + 1;
+      old = std::exchange(_current, std::make_shared<snapshot const>(snapshot{ dag, generation }));
+   }
+   KIRKPATRICK_TRACE(info, query) << "published generation" << generation << "of"
+         << dag.size() << "triangles";
+   return generation;                        // old goes away outside the lock
+}
+
+server_counters query_server::counters() const {
+   server_counters res;
+   res.connections = _connections_total;
+   res.requests = _requests;
+   res.points = _points;
+   res.reloads = _reloads;
+   res.errors = _errors;
+   return res;
+}
+
+void query_server::error(frame_header const& h, std::string const& text, session& s) {
+   frame_header const res = { frame_type::error, h.tag, uint32_t(text.size()),
+                              current()->generation };
+   size_t const at = s.output.size();
+   s.output.resize(at + sizeof(res) + text.size());
+   std::memcpy(&s.output[at], &res, sizeof(res));
+   std::memcpy(&s.output[at + sizeof(res)], text.data(), text.size());
+   ++_errors;
+}
+
+void query_server::answer(frame_header const& h, char const* payload, session& s) {
+   ++_requests;
+   if(h.type == frame_type::reload) {
+      try {
+         std::lock_guard<std::mutex> lock(_reload_mutex);
+         frame_header const res = { frame_type::reloaded, h.tag, 0,
+                                    publish(_loader(std::string(payload, h.count))) };
+         s.output.insert(s.output.end(), reinterpret_cast<char const*>(&res),
+               reinterpret_cast<char const*>(&res + 1));
+         ++_reloads;
+      } catch(std::exception const& e) {
+         error(h, e.what(), s);
+      }
+      return;
+   }
+   // The structure of this request, even if a reload publishes another one.
+   std::shared_ptr<snapshot const> const snap = current();
+   _points += h.count;
+   s.points.resize(h.count);
+   std::memcpy(s.points.data(), payload, h.count * sizeof(point_type));
+   bool const hits = h.type == frame_type::query;
+   frame_header const res = { hits ? frame_type::hits : frame_type::regions, h.tag, h.count,
+                              snap->generation };
+   size_t const at = s.output.size() + sizeof(res);
+   s.output.resize(at + h.count * item_bytes(res.type));
+   std::memcpy(&s.output[at - sizeof(res)], &res, sizeof(res));
+   if(hits) {
+      snap->dag.query_batch(s.points.data(), h.count, reinterpret_cast<uint8_t*>(&s.output[at]));
+   } else {
+      s.regions.resize(h.count);
+      snap->dag.locate_batch(s.points.data(), h.count, s.regions.data());
+      std::memcpy(&s.output[at], s.regions.data(), h.count * sizeof(region_id));
+   }
+}
+
+// Reads as much as the input has, answers the complete requests in it and
+// writes the answers at once, so a client that keeps several requests in
+// flight costs a couple of system calls per batch of them.
+void query_server::serve(int in, int out) {
+   session s;
+   size_t end = 0;                           // of the input read so far
+   try {
+      for(;;) {
+         size_t begin = 0;
+         size_t needed = sizeof(frame_header);
+         while(end - begin >= sizeof(frame_header)) {
+            frame_header h;
+            std::memcpy(&h, &s.input[begin], sizeof(h));
+            if(!is_request(h.type) || h.count > max_frame_items) {
+               error(h, is_request(h.type) ? "request too large" : "unknown request", s);
+               write_full(out, s.output.data(), s.output.size());
+               KIRKPATRICK_TRACE(info, query) << "malformed request, connection closed";
+               return;
+            }
+            size_t const size = sizeof(h) + h.count * item_bytes(h.type);
+            if(end - begin < size) {
+               needed = size;
+               break;
+            }
+            answer(h, &s.input[begin + sizeof(h)], s);
+            begin += size;
+         }
+         if(!s.output.empty()) {
+            write_full(out, s.output.data(), s.output.size());
+            s.output.clear();
+         }
+         // The partial request goes to the front, with room for all of it.
+         std::memmove(s.input.data(), s.input.data() + begin, end - begin);
+         end -= begin;
+         if(needed > s.input.size()) s.input.resize(needed);
+         ssize_t n;
+         do n = read(in, s.input.data() + end, s.input.size() - end);
+         while(n < 0 && errno == EINTR);
+         if(n < 0) throw system_error("read failed");
+         if(n == 0) {
+            if(end != 0)
+               KIRKPATRICK_TRACE(info, query) << "input ends within a request";
+            return;
+         }
+         end += size_t(n);
+      }
+   } catch(std::exception const&) {
+      // The client went away, there is nobody left to tell.
+      KIRKPATRICK_TRACE(info, query) << "connection failed";
+   }
+}
+
+void query_server::listen(std::string const& path) {
+   sockaddr_un addr;
+   std::memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if(path.size() >= sizeof(addr.sun_path))
+      throw std::runtime_error("socket path too long: " + path);
+   std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+   struct stat st;
+   if(lstat(path.c_str(), &st) == 0) {
+      if(!S_ISSOCK(st.st_mode))
+         throw std::runtime_error(path + " exists and is not a socket");
+      unlink(path.c_str());
+   }
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(fd < 0)
+      throw system_error("cannot create a socket");
+   // Only the owner may connect. Nobody can before listen(), so there is
+   // no window between bind() and chmod().
+   if(bind(fd, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) != 0 ||
+         chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(fd, SOMAXCONN) != 0) {
+      close(fd);
+      throw system_error("cannot listen on " + path);
+   }
+   KIRKPATRICK_TRACE(info, query) << "listening, generation" << generation();
+   for(;;) {
+      pollfd fds[2] = { { fd, POLLIN, 0 }, { _wake[0], POLLIN, 0 } };
+      if(poll(fds, 2, -1) < 0) {
+         if(errno == EINTR) continue;
+         close(fd);
+         throw system_error("poll failed");
+      }
+      if(fds[1].revents) {
+         char c;
+         ssize_t const ignored = read(_wake[0], &c, 1);     // ready for the next listen()
+         (void)ignored;
+         break;
+      }
+      if(!(fds[0].revents & POLLIN)) continue;
+      int client = accept(fd, nullptr, nullptr);
+      if(client < 0) continue;                 // gone already, or out of descriptors
+      reap(false);
+      std::unique_ptr<connection> c(new connection());
+      c->fd = client;
+      connection* raw = c.get();
+      c->thread = std::thread([this, raw] {
+         serve(raw->fd, raw->fd);
+         std::lock_guard<std::mutex> lock(raw->mutex);
+         close(raw->fd);
+         raw->fd = -1;
+         raw->done = true;
+      });
+      _connections.push_back(std::move(c));
+      ++_connections_total;
+      KIRKPATRICK_TRACE(info, query) << "connection" << _connections_total.load() << "open,"
+            << _connections.size() << "in all";
+   }
+   close(fd);
+   unlink(path.c_str());
+   reap(true);
+}
+
+void query_server::stop() {
+   char const c = 0;
+   ssize_t const ignored = write(_wake[1], &c, 1);     // a full pipe wakes listen() as well
+   (void)ignored;
+}
+
+void query_server::reap(bool all) {
+   for(auto it = _connections.begin(); it != _connections.end();) {
+      connection& c = **it;
+      if(!all && !c.done) {
+         ++it;
+         continue;
+      }
+      {
+         // Wakes up a connection thread blocked in read() or write().
+         std::lock_guard<std::mutex> lock(c.mutex);
+         if(c.fd >= 0) shutdown(c.fd, SHUT_RDWR);
+      }
+      c.thread.join();
+      it = _connections.erase(it);
+   }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "flat_dag.h"
+#include "protocol.h"
+
+// Totals since the server was made.
+struct server_counters {
+   uint64_t connections = 0;
+   uint64_t requests = 0;
+   uint64_t points = 0;
+   uint64_t reloads = 0;
+   uint64_t errors = 0;          // error responses sent
+};
+
+// Answers the requests of protocol.h from a flat DAG, for clients on a Unix
+// domain socket or at the other end of a pipe. Every connection has a
+// thread that answers its requests in order, each one with a single
+// query_batch() or locate_batch(). A request keeps the structure it
+// started on, so a reload swaps in a new one while the other connections
+// go on, and the old one goes away with the last request using it.
+// POSIX only. Writing to a closed connection raises SIGPIPE unless the
+// program ignores it.
+struct query_server {
+   // Makes the structure of a reload request from its path, which is empty
+   // if the request has none. The path comes from the client, the loader
+   // must refuse the ones it does not expect. Exceptions become error
+   // responses.
+   typedef std::function<flat_dag_type(std::string const& path)> loader_type;
+
+   query_server(flat_dag_type const& dag, loader_type loader);
+   ~query_server();
+   query_server(query_server const&) = delete;
+   query_server& operator=(query_server const&) = delete;
+
+   // Accepts connections on a socket at path until stop(), then closes
+   // them. The socket is only open to the user running the server. A
+   // socket left at path by an earlier server is replaced.
+   // Throws std::runtime_error if the socket cannot be set up.
+   void listen(std::string const& path);
+   // Answers the requests read from in on out, on the calling thread, until
+   // the input ends or a request is malformed. in and out may be the same
+   // socket.
+   void serve(int in, int out);
+   // Ends listen(). Only writes to a pipe, signal handlers may call it.
+   void stop();
+   // Swaps in dag for the requests that follow, returns its generation.
+   uint32_t publish(flat_dag_type const& dag);
+   uint32_t generation() const { return current()->generation; }
+   server_counters counters() const;
+private:
+   struct snapshot {
+      flat_dag_type dag;
+      uint32_t generation;
+   };
+   struct session;
+   struct connection;
+   std::shared_ptr<snapshot const> current() const;
+   // Appends the response to the request h to the output of s.
+   void answer(frame_header const& h, char const* payload, session& s);
+   void error(frame_header const& h, std::string const& text, session& s);
+   // Joins the threads of the connections that have ended, or ends all of
+   // them and joins their threads.
+   void reap(bool all);
+private:
+   loader_type _loader;
+   mutable std::mutex _mutex;                // of _current
+   std::shared_ptr<snapshot const> _current;
+   std::mutex _reload_mutex;                 // one reload at a time
+   std::list<std::unique_ptr<connection> > _connections;
+   int _wake[2] = { -1, -1 };                // written by stop()
+   std::atomic<uint64_t> _connections_total{0}, _requests{0}, _points{0}, _reloads{0},
+         _errors{0};
+};
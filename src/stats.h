@@ -0,0 +1,82 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <boost/container/small_vector.hpp>
+
+// Work done by one query, see basic_flat_dag::locate(pt, query_stats&).
+struct query_stats {
+   size_t depth = 0;             // of the deepest leaf reached, the top triangle is 0
+   size_t triangles_tested = 0;  // with predicates, the top triangle included
+   size_t orientations = 0;      // predicates evaluated by those tests
+   size_t branches = 0;          // nodes with the point in several children
+};
+
+// Shape of a built hierarchy, see basic_flat_dag::shape().
+struct dag_shape {
+   size_t triangles = 0;
+   size_t leaves = 0;
+   size_t depth = 0;             // longest path from the top triangle to a leaf
+   // fan_out[k] is the number of inner nodes with k children.
+   std::vector<size_t> fan_out;
+
+   // Children per inner node.
+   double mean_fan_out() const {
+      size_t inner = 0, children = 0;
+      for(size_t k = 0; k != fan_out.size(); ++k) {
+         inner += fan_out[k];
+         children += k * fan_out[k];
+      }
+      return inner ? double(children) / inner : 0;
+   }
+};
+
+// Where a build spent its time, see basic_kirkpatrick::profile().
+struct build_profile {
+   struct level {
+      size_t vertices;           // in the graph before the level
+      size_t removed;            // independent set taken out
+      double seconds;
+   };
+   double triangulation = 0;     // seconds
+   std::vector<level> levels;    // one per refinement, bottom up
+   double freeze = 0;            // building the flat DAG
+   // Blocks of build_options::arena: kept with the triangles, and freed
+   // after the build.
+   size_t arena_bytes = 0;
+   size_t scratch_bytes = 0;
+};
+
+// The query descent is written once against a probe. The disabled probe is
+// empty and every call to it compiles to nothing, so uninstrumented queries
+// pay nothing for the counters.
+template<bool Enabled>
+struct query_probe {
+   explicit query_probe(query_stats*) { }
+   void tested() { }
+   void oriented(int) { }
+   void branched() { }
+   void push() { }               // a child of the current node is stacked
+   void pop() { }                // the last stacked node becomes current
+   void leaf() { }
+};
+
+template<>
+struct query_probe<true> {
+   explicit query_probe(query_stats* stats): _stats(stats), _depths(1, 0) {
+      *_stats = query_stats();
+   }
+   void tested() { ++_stats->triangles_tested; }
+   void oriented(int tests) { _stats->orientations += size_t(tests); }
+   void branched() { ++_stats->branches; }
+   void push() { _depths.push_back(_current + 1); }
+   void pop() { _current = _depths.back(); _depths.pop_back(); }
+   void leaf() { _stats->depth = std::max<size_t>(_stats->depth, _current); }
+private:
+   query_stats* _stats;
+   boost::container::small_vector<uint32_t, 64> _depths;
+   uint32_t _current = 0;
+};
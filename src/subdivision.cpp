@@ -0,0 +1,352 @@
+#include "subdivision.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+uint32_t const none = uint32_t(-1);
+
+uint64_t edge_key(vertex_id a, vertex_id b) { return uint64_t(a) << 32 | b; }
+
+// Triangle of the working triangulation, counter-clockwise. n[i] is the
+// neighbour across the edge opposite v[i], v[0] == none marks a dead one.
+struct cdt_triangle {
+   triangle_ids v;
+   std::array<uint32_t, 3> n;
+};
+
+// Sweep triangulation of the points, then the region edges are forced in
+// one at a time: the triangles crossed by an edge are removed and the two
+// polygons on its sides are ear clipped again.
+template<class Kernel>
+struct constrained_triangulation {
+   typedef typename Kernel::point_arr point_arr;
+
+   explicit constrained_triangulation(point_arr const& points);
+   void insert(region_edge const&);
+   std::vector<labelled_triangle> labels() const;
+private:
+   int orient(vertex_id a, vertex_id b, vertex_id c) const {
+      return orientation(_points[a], _points[b], _points[c]);
+   }
+   bool constrained(vertex_id a, vertex_id b) const {
+      return _left_of.count(edge_key(a, b)) || _left_of.count(edge_key(b, a));
+   }
+   uint32_t add(vertex_id a, vertex_id b, vertex_id c);
+   size_t third(uint32_t t, vertex_id a, vertex_id b) const;
+   void link(uint32_t t, uint32_t u, vertex_id a, vertex_id b);
+   void sweep(vertex_id p, vertex_id q);
+   vertex_id insert_segment(vertex_id a, vertex_id b);
+   void clip(std::vector<vertex_id> poly, std::vector<triangle_ids>& res) const;
+private:
+   point_arr const& _points;
+   std::vector<cdt_triangle> _triangles;
+   std::vector<uint32_t> _vertex_triangle;    // any live triangle around the vertex
+   // Hull of the swept points, counter-clockwise. _hull_triangle[v] is the
+   // triangle on the edge v -> _next[v].
+   std::vector<vertex_id> _next, _prev;
+   std::vector<uint32_t> _hull_triangle;
+   std::unordered_map<uint64_t, region_id> _left_of;
+};
+
+template<class Kernel>
+constrained_triangulation<Kernel>::constrained_triangulation(point_arr const& points):
+   _points(points), _vertex_triangle(points.size(), none), _next(points.size(), none),
+   _prev(points.size(), none), _hull_triangle(points.size(), none) {
+   vertex_arr order(points.size());
+   std::iota(order.begin(), order.end(), vertex_id(0));
+   std::sort(order.begin(), order.end(), [&](vertex_id a, vertex_id b) {
+      return points[a] < points[b];
+   });
+   vertex_id a = order[0], b = order[1], c = order[2];
+   int o = orient(a, b, c);
+   if(o == 0)
+      throw std::logic_error("the sweep starts with collinear points");
+   if(o < 0) std::swap(b, c);
+   uint32_t t = add(a, b, c);
+   _next[a] = b; _next[b] = c; _next[c] = a;
+   _prev[b] = a; _prev[c] = b; _prev[a] = c;
+   _hull_triangle[a] = _hull_triangle[b] = _hull_triangle[c] = t;
+   for(size_t i = 3; i < order.size(); ++i)
+      sweep(order[i], order[i - 1]);
+   _next.clear();
+   _prev.clear();
+   _hull_triangle.clear();
+}
+
+template<class Kernel>
+uint32_t constrained_triangulation<Kernel>::add(vertex_id a, vertex_id b, vertex_id c) {
+   uint32_t t = uint32_t(_triangles.size());
+   _triangles.push_back({ {{ a, b, c }}, {{ none, none, none }} });
+   _vertex_triangle[a] = _vertex_triangle[b] = _vertex_triangle[c] = t;
+   return t;
+}
+
+// Index of the vertex of t that is neither a nor b.
+template<class Kernel>
+size_t constrained_triangulation<Kernel>::third(uint32_t t, vertex_id a, vertex_id b) const {
+   triangle_ids const& v = _triangles[t].v;
+   for(size_t i = 0; i != 3; ++i)
+      if(v[i] != a && v[i] != b) return i;
+   throw std::logic_error("degenerate triangle");
+}
+
+template<class Kernel>
+void constrained_triangulation<Kernel>::link(uint32_t t, uint32_t u, vertex_id a, vertex_id b) {
+   if(t != none) _triangles[t].n[third(t, a, b)] = u;
+   if(u != none) _triangles[u].n[third(u, a, b)] = t;
+}
+
+// p comes after all the swept points, q is the one swept last. p sees a
+// chain of hull edges next to q and is joined to all of them.
+template<class Kernel>
+void constrained_triangulation<Kernel>::sweep(vertex_id p, vertex_id q) {
+   uint32_t first_next = none, last_next = none;
+   vertex_id h = q;
+   while(orient(h, _next[h], p) < 0) {
+      vertex_id n = _next[h];
+      uint32_t t = add(n, h, p);
+      link(t, _hull_triangle[h], h, n);
+      link(t, last_next, h, p);
+      if(first_next == none) first_next = t;
+      last_next = t;
+      h = n;
+   }
+   vertex_id const next_end = h;
+   uint32_t first_prev = none, last_prev = none;
+   h = q;
+   while(orient(_prev[h], h, p) < 0) {
+      vertex_id r = _prev[h];
+      uint32_t t = add(h, r, p);
+      link(t, _hull_triangle[r], r, h);
+      link(t, last_prev, h, p);
+      if(first_prev == none) first_prev = t;
+      last_prev = t;
+      h = r;
+   }
+   vertex_id const prev_end = h;
+   if(first_next == none && first_prev == none)
+      throw std::logic_error("swept point sees no hull edge");
+   link(first_next, first_prev, q, p);
+   _next[prev_end] = p;
+   _prev[p] = prev_end;
+   _next[p] = next_end;
+   _prev[next_end] = p;
+   _hull_triangle[prev_end] = last_prev != none ? last_prev : first_next;
+   _hull_triangle[p] = last_next != none ? last_next : first_prev;
+}
+
+// Ear clipping of a small counter-clockwise polygon.
+template<class Kernel>
+void constrained_triangulation<Kernel>::clip(std::vector<vertex_id> poly,
+      std::vector<triangle_ids>& res) const {
+   size_t i = 0, tried = 0;
+   while(poly.size() > 3) {
+      size_t const n = poly.size();
+      i %= n;
+      vertex_id p = poly[(i + n - 1) % n], v = poly[i], q = poly[(i + 1) % n];
+      bool ear = orient(p, v, q) > 0;
+      for(size_t k = 0; ear && k != n; ++k) {
+         vertex_id x = poly[k];
+         if(x == p || x == v || x == q) continue;
+         if(inside_triangle(_points[p], _points[v], _points[q], _points[x])) ear = false;
+      }
+      if(!ear) {
+         if(++tried > n)
+            throw std::logic_error("no ear left in a cavity");
+         ++i;
+         continue;
+      }
+      res.push_back({{ p, v, q }});
+      poly.erase(poly.begin() + i);
+      if(i != 0) --i;
+      tried = 0;
+   }
+   res.push_back({{ poly[0], poly[1], poly[2] }});
+}
+
+// Makes the part of a -> b up to the first vertex on it an edge of the
+// triangulation and returns that vertex.
+template<class Kernel>
+vertex_id constrained_triangulation<Kernel>::insert_segment(vertex_id a, vertex_id b) {
+   auto same_direction = [&](vertex_id u) {
+      auto const& pa = _points[a];
+      auto const& pb = _points[b];
+      auto const& pu = _points[u];
+      return (pu.x > pa.x) == (pb.x > pa.x) && (pu.x < pa.x) == (pb.x < pa.x) &&
+             (pu.y > pa.y) == (pb.y > pa.y) && (pu.y < pa.y) == (pb.y < pa.y);
+   };
+   // Look for the triangle around a that the segment leaves a through.
+   uint32_t const start = _vertex_triangle[a];
+   uint32_t t = start, found = none;
+   bool backwards = false;
+   vertex_id r = none, l = none;
+   while(t != none) {
+      triangle_ids const& v = _triangles[t].v;
+      size_t i = std::find(v.begin(), v.end(), a) - v.begin();
+      vertex_id u = v[(i + 1) % 3], w = v[(i + 2) % 3];
+      for(vertex_id x: { u, w }) {
+         if(x == b) return b;
+         if(orient(a, b, x) == 0 && same_direction(x)) return x;
+      }
+      if(orient(a, b, u) < 0 && orient(a, b, w) > 0) {
+         found = t;
+         r = u;
+         l = w;
+         break;
+      }
+      // Counter-clockwise around a is across a - w, clockwise across a - u.
+      t = _triangles[t].n[backwards ? (i + 2) % 3 : (i + 1) % 3];
+      if(t == start) break;
+      if(t == none && !backwards) {
+         backwards = true;
+         t = _triangles[start].n[(std::find(_triangles[start].v.begin(),
+                  _triangles[start].v.end(), a) - _triangles[start].v.begin() + 2) % 3];
+      }
+   }
+   if(found == none)
+      throw std::logic_error("region edge leaves the triangulation");
+
+   // Walk along the segment, the crossed triangles form the cavity.
+   std::vector<uint32_t> cavity(1, found);
+   vertex_arr left(1, l), right(1, r);
+   vertex_id end = none;
+   for(uint32_t cur = found;;) {
+      if(constrained(r, l))
+         throw std::invalid_argument("region edges cross");
+      uint32_t next = _triangles[cur].n[third(cur, r, l)];
+      if(next == none)
+         throw std::logic_error("region edge leaves the triangulation");
+      cavity.push_back(next);
+      vertex_id s = _triangles[next].v[third(next, r, l)];
+      int o = s == b ? 0 : orient(a, b, s);
+      if(o == 0) {
+         end = s;
+         break;
+      }
+      if(o < 0) right.push_back(r = s);
+      else left.push_back(l = s);
+      cur = next;
+   }
+
+   // Outside neighbours of the cavity by edge.
+   std::sort(cavity.begin(), cavity.end());
+   std::unordered_map<uint64_t, uint32_t> outside;
+   for(auto c: cavity) {
+      cdt_triangle const& ct = _triangles[c];
+      for(size_t j = 0; j != 3; ++j) {
+         if(std::binary_search(cavity.begin(), cavity.end(), ct.n[j])) continue;
+         vertex_id x = ct.v[(j + 1) % 3], y = ct.v[(j + 2) % 3];
+         outside[edge_key(std::min(x, y), std::max(x, y))] = ct.n[j];
+      }
+   }
+   for(auto c: cavity) _triangles[c].v[0] = none;
+
+   std::vector<triangle_ids> patch;
+   vertex_arr poly = { a, end };
+   poly.insert(poly.end(), left.rbegin(), left.rend());
+   clip(poly, patch);
+   poly = { end, a };
+   poly.insert(poly.end(), right.begin(), right.end());
+   clip(poly, patch);
+
+   std::unordered_map<uint64_t, uint32_t> inside;
+   for(auto const& ids: patch) {
+      uint32_t nt = add(ids[0], ids[1], ids[2]);
+      for(size_t j = 0; j != 3; ++j) {
+         vertex_id x = ids[(j + 1) % 3], y = ids[(j + 2) % 3];
+         uint64_t key = edge_key(std::min(x, y), std::max(x, y));
+         auto it = outside.find(key);
+         if(it != outside.end()) {
+            link(nt, it->second, x, y);
+            continue;
+         }
+         auto jt = inside.emplace(key, nt);
+         if(!jt.second) link(nt, jt.first->second, x, y);
+      }
+   }
+   return end;
+}
+
+template<class Kernel>
+void constrained_triangulation<Kernel>::insert(region_edge const& e) {
+   for(vertex_id a = e.from; a != e.to;) {
+      vertex_id c = insert_segment(a, e.to);
+      // The same region on both sides, like holes sharing an edge.
+      auto back = _left_of.find(edge_key(c, a));
+      if(back != _left_of.end() && back->second == e.region) {
+         _left_of.erase(back);
+         a = c;
+         continue;
+      }
+      auto it = _left_of.emplace(edge_key(a, c), e.region);
+      if(it.first->second != e.region)
+         throw std::invalid_argument("regions overlap");
+      a = c;
+   }
+}
+
+// Regions spread from their edges to the triangles that are not separated
+// from them by another region edge.
+template<class Kernel>
+std::vector<labelled_triangle> constrained_triangulation<Kernel>::labels() const {
+   std::vector<region_id> region(_triangles.size(), no_region);
+   std::vector<uint32_t> stack;
+   for(uint32_t t = 0; t != _triangles.size(); ++t) {
+      cdt_triangle const& ct = _triangles[t];
+      if(ct.v[0] == none) continue;
+      for(size_t j = 0; j != 3; ++j) {
+         auto it = _left_of.find(edge_key(ct.v[(j + 1) % 3], ct.v[(j + 2) % 3]));
+         if(it == _left_of.end()) continue;
+         if(region[t] != no_region && region[t] != it->second)
+            throw std::invalid_argument("regions overlap");
+         if(region[t] == no_region) stack.push_back(t);
+         region[t] = it->second;
+      }
+   }
+   while(!stack.empty()) {
+      uint32_t t = stack.back();
+      stack.pop_back();
+      cdt_triangle const& ct = _triangles[t];
+      for(size_t j = 0; j != 3; ++j) {
+         uint32_t u = ct.n[j];
+         if(u == none || constrained(ct.v[(j + 1) % 3], ct.v[(j + 2) % 3])) continue;
+         if(region[u] == region[t]) continue;
+         if(region[u] != no_region)
+            throw std::invalid_argument("regions overlap");
+         region[u] = region[t];
+         stack.push_back(u);
+      }
+   }
+   std::vector<labelled_triangle> res;
+   for(uint32_t t = 0; t != _triangles.size(); ++t) {
+      triangle_ids const& v = _triangles[t].v;
+      if(v[0] == none) continue;
+      // Only a ring turned the wrong way, like a hole outside of its
+      // polygon, lets a region spread to the outer triangle.
+      if(region[t] != no_region && (v[0] < 3 || v[1] < 3 || v[2] < 3))
+         throw std::invalid_argument("a region is not enclosed by its boundary");
+      res.push_back({ v, region[t] });
+   }
+   return res;
+}
+
+} // namespace
+
+template<class Kernel>
+std::vector<labelled_triangle> triangulate_subdivision(
+      typename Kernel::point_arr const& points, std::vector<region_edge> const& edges) {
+   if(points.size() < 3)
+      throw std::logic_error("subdivision without an outer triangle");
+   constrained_triangulation<Kernel> cdt(points);
+   for(auto const& e: edges) cdt.insert(e);
+   return cdt.labels();
+}
+
+#define INSTANTIATE(K) \
+   template std::vector<labelled_triangle> triangulate_subdivision<K>( \
+         K::point_arr const&, std::vector<region_edge> const&);
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "graph.h"
+#include "triangle.h"
+
+// Directed boundary edge of a region, the region lies to its left.
+struct region_edge {
+   vertex_id from;
+   vertex_id to;
+   region_id region;
+};
+
+struct labelled_triangle {
+   triangle_ids ids;             // counter-clockwise
+   region_id region;
+};
+
+// Triangulation of a planar subdivision that keeps every region edge.
+// points are indexed by vertex_id and distinct, the first three form a
+// counter-clockwise triangle that strictly contains all the others. The
+// result covers that triangle. An edge passing through another vertex is
+// split there, an edge given both ways for one region is dropped. Every
+// triangle gets the region on the left of the edges that enclose it,
+// no_region outside of all regions.
+// Throws std::invalid_argument if region edges cross, regions overlap or
+// a region reaches the outer triangle.
+template<class Kernel>
+std::vector<labelled_triangle> triangulate_subdivision(
+      typename Kernel::point_arr const& points, std::vector<region_edge> const& edges);
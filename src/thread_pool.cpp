@@ -0,0 +1,101 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+work_stealing_pool::work_stealing_pool(size_t threads) {
+   if(threads == 0) threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+   for(size_t i = 0; i != threads; ++i)
+      _queues.emplace_back(new task_queue());
+   for(size_t i = 0; i != threads; ++i)
+      _threads.emplace_back(&work_stealing_pool::worker_loop, this, i);
+}
+
+work_stealing_pool::~work_stealing_pool() {
+   {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+   }
+   _wake.notify_all();
+   for(auto& t: _threads) t.join();
+}
+
+void work_stealing_pool::run(size_t count, task_type const& task) {
+   if(count == 0) return;
+   std::lock_guard<std::mutex> run_lock(_run_mutex);
+   std::unique_lock<std::mutex> lock(_mutex);
+   // Contiguous ranges per worker, so neighbouring tasks stay on one core
+   // unless somebody has to steal them.
+   size_t const workers = _queues.size();
+   for(size_t w = 0; w != workers; ++w) {
+      std::lock_guard<std::mutex> queue_lock(_queues[w]->mutex);
+      for(size_t i = count * w / workers; i != count * (w + 1) / workers; ++i)
+         _queues[w]->tasks.push_back(i);
+   }
+   _task = &task;
+   _error = nullptr;
+   _failed = false;
+   _pending = count;
+   ++_generation;
+   _wake.notify_all();
+   // Workers still inside the loop hold a pointer to task.
+   _done.wait(lock, [this] { return _pending == 0 && _busy == 0; });
+   _task = nullptr;
+   if(_error) {
+      std::exception_ptr error = _error;
+      _error = nullptr;
+      std::rethrow_exception(error);
+   }
+}
+
+bool work_stealing_pool::pop(size_t id, size_t& task) {
+   {
+      task_queue& own = *_queues[id];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if(!own.tasks.empty()) {
+         task = own.tasks.back();
+         own.tasks.pop_back();
+         return true;
+      }
+   }
+   for(size_t k = 1; k != _queues.size(); ++k) {
+      task_queue& victim = *_queues[(id + k) % _queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if(!victim.tasks.empty()) {
+         task = victim.tasks.front();
+         victim.tasks.pop_front();
+         return true;
+      }
+   }
+   return false;
+}
+
+void work_stealing_pool::worker_loop(size_t id) {
+   size_t seen = 0;
+   for(;;) {
+      task_type const* task;
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+         _wake.wait(lock, [&] { return _stop || _generation != seen; });
+         if(_stop) return;
+         seen = _generation;
+         task = _task;
+         ++_busy;
+      }
+      size_t i;
+      // A worker that wakes up after the run finished has no task and must
+      // not take the tasks of the next run.
+      while(task && pop(id, i)) {
+         try {
+            if(!_failed) (*task)(i, id);
+         } catch(...) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if(!_error) _error = std::current_exception();
+            _failed = true;
+         }
+         --_pending;
+      }
+      std::lock_guard<std::mutex> lock(_mutex);
+      --_busy;
+      _done.notify_all();
+   }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own deque of task indices. A worker
+// takes tasks from the back of its own deque and, once it runs dry, steals
+// from the front of the others.
+struct work_stealing_pool {
+   // task index, worker index
+   typedef std::function<void(size_t, size_t)> task_type;
+
+   explicit work_stealing_pool(size_t threads = 0);       // 0 means one per core
+   ~work_stealing_pool();
+   work_stealing_pool(work_stealing_pool const&) = delete;
+   work_stealing_pool& operator=(work_stealing_pool const&) = delete;
+
+   size_t size() const { return _threads.size(); }
+   // Runs task(0) ... task(count - 1) on the workers, returns when all are done.
+   // Calls are serialized. Once a task throws, the tasks not started yet are
+   // skipped, and run() rethrows the first exception after the others ended.
+   void run(size_t count, task_type const& task);
+private:
+   struct task_queue {
+      std::mutex mutex;
+      std::deque<size_t> tasks;
+   };
+   void worker_loop(size_t id);
+   bool pop(size_t id, size_t& task);
+private:
+   std::vector<std::unique_ptr<task_queue> > _queues;
+   std::vector<std::thread> _threads;
+   std::mutex _run_mutex;
+   std::mutex _mutex;
+   std::condition_variable _wake;
+   std::condition_variable _done;
+   task_type const* _task = nullptr;
+   std::exception_ptr _error;                // first one thrown by a task of this run
+   std::atomic<bool> _failed{false};
+   std::atomic<size_t> _pending{0};
+   size_t _busy = 0;
+   size_t _generation = 0;
+   bool _stop = false;
+};
@@ -0,0 +1,116 @@
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+namespace {
+
+#ifdef QT_DEBUG
+uint8_t const initial_level = uint8_t(trace_level::verbose);
+#else
+uint8_t const initial_level = uint8_t(trace_level::off);
+#endif
+
+std::ostream* trace_stream = &std::cerr;
+trace_ring* trace_sink = nullptr;
+std::mutex stream_mutex;               // keeps lines of several threads apart
+
+} // namespace
+
+std::atomic<uint8_t> trace_levels[trace_category_count] = {
+   { initial_level }, { initial_level }, { initial_level } };
+
+char const* to_string(trace_level level) {
+   switch(level) {
+   case trace_level::off: return "off";
+   case trace_level::info: return "info";
+   case trace_level::debug: return "debug";
+   case trace_level::verbose: return "verbose";
+   }
+   return "?";
+}
+
+char const* to_string(trace_category category) {
+   switch(category) {
+   case trace_category::build: return "build";
+   case trace_category::refine: return "refine";
+   case trace_category::query: return "query";
+   }
+   return "?";
+}
+
+std::ostream& operator<<(std::ostream& ost, trace_record const& r) {
+   char time[32];
+   std::snprintf(time, sizeof(time), "%.6f", r.time * 1e-9);
+   ost << time << " " << to_string(r.category) << " " << to_string(r.level) << ":";
+   for(size_t i = 0; i != trace_record::max_items && r.kinds[i] != trace_record::none; ++i) {
+      trace_record::item const& it = r.items[i];
+      ost << " ";
+      switch(r.kinds[i]) {
+      case trace_record::text: ost << it.text; break;
+      case trace_record::integer: ost << it.integer; break;
+      case trace_record::real: ost << it.real; break;
+      case trace_record::point: ost << "(" << it.point[0] << ", " << it.point[1] << ")"; break;
+      case trace_record::none: break;
+      }
+   }
+   return ost;
+}
+
+trace_ring::trace_ring(size_t capacity) {
+   size_t n = 1;
+   while(n < capacity) n *= 2;
+   _records.resize(n);
+}
+
+void trace_ring::push(trace_record const& r) {
+   uint64_t const i = _next.fetch_add(1, std::memory_order_relaxed);
+   _records[i & (_records.size() - 1)] = r;
+}
+
+std::vector<trace_record> trace_ring::records() const {
+   uint64_t const next = _next.load();
+   uint64_t const first = next > _records.size() ? next - _records.size() : 0;
+   std::vector<trace_record> res;
+   res.reserve(size_t(next - first));
+   for(uint64_t i = first; i != next; ++i)
+      res.push_back(_records[i & (_records.size() - 1)]);
+   return res;
+}
+
+size_t trace_ring::overwritten() const {
+   uint64_t const next = _next.load();
+   return next > _records.size() ? size_t(next - _records.size()) : 0;
+}
+
+void set_trace_level(trace_category category, trace_level level) {
+   trace_levels[size_t(category)] = uint8_t(level);
+}
+
+void set_trace_level(trace_level level) {
+   for(auto& l: trace_levels) l = uint8_t(level);
+}
+
+void set_trace_stream(std::ostream* ost) { trace_stream = ost; }
+void set_trace_ring(trace_ring* ring) { trace_sink = ring; }
+
+trace_line::trace_line(trace_level level, trace_category category) {
+   _record.time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now().time_since_epoch()).count());
+   _record.level = level;
+   _record.category = category;
+   for(auto& k: _record.kinds) k = trace_record::none;
+}
+
+trace_line::~trace_line() {
+   if(trace_sink) trace_sink->push(_record);
+   if(trace_stream) {
+      std::ostringstream line;
+      line << _record << "\n";
+      std::lock_guard<std::mutex> lock(stream_mutex);
+      *trace_stream << line.str() << std::flush;
+   }
+}
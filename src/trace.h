@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <type_traits>
+#include <vector>
+
+// Structured tracing. A statement
+//
+//    KIRKPATRICK_TRACE(debug, refine) << "independent set" << iset.size();
+//
+// records one line of up to trace_record::max_items values: string
+// literals, numbers and points. Statements above KIRKPATRICK_TRACE_LEVEL
+// are compiled out, the others are filtered per category at run time. Either
+// way the values after the macro are only evaluated when the line is kept.
+//
+//    info     build phases and refinement levels
+//    debug    every triangle, ear, pocket and hole patch of a build
+//    verbose  every triangle a query descends through
+
+#ifndef KIRKPATRICK_TRACE_LEVEL
+#ifdef QT_DEBUG
+#define KIRKPATRICK_TRACE_LEVEL 3
+#else
+#define KIRKPATRICK_TRACE_LEVEL 0
+#endif
+#endif
+
+enum class trace_level : uint8_t { off, info, debug, verbose };
+enum class trace_category : uint8_t { build, refine, query };
+const size_t trace_category_count = 3;
+
+char const* to_string(trace_level);
+char const* to_string(trace_category);
+
+// One line, one cache line. Text items point to the string literals of the
+// trace statements.
+struct trace_record {
+   static const size_t max_items = 6;
+   enum item_kind : uint8_t { none, text, integer, real, point };
+   union item {
+      char const* text;
+      int64_t integer;
+      double real;
+      int32_t point[2];
+   };
+
+   uint64_t time;                // steady clock, nanoseconds
+   trace_level level;
+   trace_category category;
+   item_kind kinds[max_items];   // none after the last item
+   item items[max_items];
+};
+
+// Prints the record as one line without the line break.
+std::ostream& operator<<(std::ostream&, trace_record const&);
+
+// The most recent records in a buffer allocated up front. Pushing a record
+// copies 64 bytes and formats nothing, so a build can be traced at the debug
+// level for a fraction of the cost of printing it.
+struct trace_ring {
+   explicit trace_ring(size_t capacity);      // rounded up to a power of two
+   void push(trace_record const&);
+   // Oldest first. Only consistent while nothing is being traced.
+   std::vector<trace_record> records() const;
+   size_t overwritten() const;
+   void clear() { _next = 0; }
+private:
+   std::vector<trace_record> _records;
+   std::atomic<uint64_t> _next{0};
+};
+
+// Lines of category up to level reach the sinks. Everything is off by
+// default, except in debug builds of the viewer.
+void set_trace_level(trace_category, trace_level);
+void set_trace_level(trace_level);            // of every category
+// The sinks, nullptr turns one off. Lines go to the stream (std::cerr by
+// default) and to the ring. Not to be changed while other threads trace.
+void set_trace_stream(std::ostream*);
+void set_trace_ring(trace_ring*);
+
+extern std::atomic<uint8_t> trace_levels[trace_category_count];
+
+inline bool trace_enabled(trace_level level, trace_category category) {
+   return uint8_t(level) <= KIRKPATRICK_TRACE_LEVEL &&
+         uint8_t(level) <= trace_levels[size_t(category)].load(std::memory_order_relaxed);
+}
+
+// Collects one record, it goes to the sinks at the end of the statement.
+// Items past max_items are dropped.
+struct trace_line {
+   trace_line(trace_level, trace_category);
+   ~trace_line();
+   trace_line(trace_line const&) = delete;
+   trace_line& operator=(trace_line const&) = delete;
+
+   trace_line& operator<<(char const* s) {
+      if(item* it = next(trace_record::text)) it->text = s;
+      return *this;
+   }
+
+   template<class T>
+   typename std::enable_if<std::is_arithmetic<T>::value, trace_line&>::type operator<<(T v) {
+      if(std::is_floating_point<T>::value) {
+         if(item* it = next(trace_record::real)) it->real = double(v);
+      } else {
+         if(item* it = next(trace_record::integer)) it->integer = int64_t(v);
+      }
+      return *this;
+   }
+
+   // Points of any kernel, int32 ones take a single item.
+   template<class Point>
+   auto operator<<(Point const& p) -> decltype(p.x, p.y, *this) {
+      if(std::is_same<typename std::decay<decltype(p.x)>::type, int32_t>::value) {
+         if(item* it = next(trace_record::point)) {
+            it->point[0] = int32_t(p.x);
+            it->point[1] = int32_t(p.y);
+         }
+         return *this;
+      }
+      return *this << p.x << p.y;
+   }
+private:
+   typedef trace_record::item item;
+   item* next(trace_record::item_kind kind) {
+      if(_count == trace_record::max_items) return nullptr;
+      _record.kinds[_count] = kind;
+      return &_record.items[_count++];
+   }
+private:
+   trace_record _record;
+   size_t _count = 0;
+};
+
+// The loop runs at most once and keeps the macro a single statement, so it
+// can stand anywhere a statement can, if/else included.
+#define KIRKPATRICK_TRACE(level, category) \
+   for(bool kirkpatrick_trace_on = trace_enabled(trace_level::level, \
+            trace_category::category); kirkpatrick_trace_on; kirkpatrick_trace_on = false) \
+      trace_line(trace_level::level, trace_category::category)
@@ -1,56 +1,42 @@
 #include "triangle.h"
 
-bool intersects(triangle_type const& t1, triangle_type const& t2) {
-   segment_arr s1, s2;
-   s1.push_back(segment_type(t1.p1(), t1.p2()));
-   s1.push_back(segment_type(t1.p3(), t1.p2()));
-   s1.push_back(segment_type(t1.p1(), t1.p3()));
-   s2.push_back(segment_type(t2.p1(), t2.p2()));
-   s2.push_back(segment_type(t2.p3(), t2.p2()));
-   s2.push_back(segment_type(t2.p1(), t2.p3()));
+#include "trace.h"
+
+template<class Kernel>
+bool intersects(basic_triangle<Kernel> const& t1, basic_triangle<Kernel> const& t2) {
+   typedef typename Kernel::point_type point_type;
+   point_type const s1[3][2] = { { t1.p1(), t1.p2() }, { t1.p3(), t1.p2() }, { t1.p1(), t1.p3() } };
+   point_type const s2[3][2] = { { t2.p1(), t2.p2() }, { t2.p3(), t2.p2() }, { t2.p1(), t2.p3() } };
    bool res = false;
-   for(auto x: s1) {
-      for(auto y: s2) {
-         if(intersects(x, y)) res = true;
+   for(auto const& x: s1) {
+      for(auto const& y: s2) {
+         if(segments_intersect(x[0], x[1], y[0], y[1])) res = true;
       }
    }
    return res;
 }
 
-bool triangle_type::inside(point_type const& pt) const {
+template<class Kernel>
+bool basic_triangle<Kernel>::inside(point_type const& pt) const {
    return inside_triangle(_p1, _p2, _p3, pt);
 }
 
-bool triangle_type::query(point_type const& pt) const {
-   logger << "Querying " << pt << " inside " << *this << std::endl;
+template<class Kernel>
+region_id basic_triangle<Kernel>::locate(point_type const& pt) const {
+   KIRKPATRICK_TRACE(verbose, query) << "triangle" << _p1 << _p2 << _p3 << "test" << pt;
    if(!inside(pt))
-       return false;
-   logger << "Point is inside" << std::endl;
+       return no_region;
    if(_children.empty())
-       return _is_inside;
-   logger << "Iterating over children" << std::endl;
+       return _region;
    for(auto t: _children) {
-      if (t->query(pt))
-          return true;
+      region_id res = t->locate(pt);
+      if(res != no_region)
+          return res;
    }
-   return false;
+   return no_region;
 }
 
-void triangle_drawer::draw_inside_triangles(visualization::drawer_type &drawer, triangle_ptr father) const  {
-
-       if (father == nullptr)
-           return;
-       drawer.set_color(Qt::yellow);
-       double width = 6;
-
-       if (father->_is_inside)   {
-
-            drawer.draw_line(father->p1(), father->p2(), width);
-            drawer.draw_line(father->p2(), father->p3(), width);
-            drawer.draw_line(father->p3(), father->p1(), width);
-
-       }
-        for (auto t : father->_children) {
-            draw_inside_triangles(drawer, t);
-        }
-}
+#define INSTANTIATE(K) \
+   template struct basic_triangle<K>; \
+   template bool intersects(basic_triangle<K> const&, basic_triangle<K> const&);
+KIRKPATRICK_FOR_EACH_KERNEL(INSTANTIATE)
@@ -1,54 +1,72 @@
 #pragma once
 
 #include "util.h"
+#include <cstdint>
 #include <memory>
+#include <memory_resource>
 #include <vector>
-#include <visualization/viewer_adapter.h>
 
-struct triangle_type;
-typedef std::shared_ptr<triangle_type> triangle_ptr;
+// Label of a leaf triangle: the index of the region (polygon) it lies in.
+typedef int32_t region_id;
+const region_id no_region = -1;
 
-class triangle_drawer   {
-public:
-    triangle_drawer() {}
-    void draw_inside_triangles(visualization::drawer_type& drawer, triangle_ptr father) const;
-};
+template<class Kernel>
+struct basic_triangle;
+
+template<class Kernel>
+using basic_triangle_ptr = std::shared_ptr<basic_triangle<Kernel> >;
+
+template<class Kernel>
+struct basic_triangle {
+   typedef typename Kernel::point_type point_type;
+   typedef basic_triangle_ptr<Kernel> triangle_ptr;
 
-struct triangle_type {
-   triangle_type(point_type const& p1, point_type const& p2, point_type const& p3,
-         bool is_inside): _p1(p1), _p2(p2), _p3(p3), _is_inside(is_inside) { }
+   typedef std::pmr::vector<triangle_ptr> triangle_list;
+
+   // The children list takes its memory from resource, see build_arena.
+   basic_triangle(point_type const& p1, point_type const& p2, point_type const& p3,
+         region_id region,
+         std::pmr::memory_resource* resource = std::pmr::get_default_resource()):
+      _p1(p1), _p2(p2), _p3(p3), _children(resource), _region(region) { }
    bool inside(point_type const& pt) const;
-   bool query(point_type const& pt) const;
+   bool query(point_type const& pt) const { return locate(pt) != no_region; }
+   // Region of the first leaf containing pt, no_region if there is none.
+   region_id locate(point_type const& pt) const;
    void add_child(triangle_ptr const& t) { _children.push_back(t); }
    template<class Cont>
    void add_children(Cont const& ts);
    point_type const& p1() const { return _p1; }
    point_type const& p2() const { return _p2; }
    point_type const& p3() const { return _p3; }
-
-   friend void triangle_drawer::draw_inside_triangles(visualization::drawer_type& drawer,
-                                               triangle_ptr father) const;
-   friend std::ostream& operator<<(std::ostream&, triangle_type const&);
+   triangle_list const& children() const { return _children; }
+   region_id region() const { return _region; }
+   bool is_inside() const { return _region != no_region; }
 private:
    point_type _p1;
    point_type _p2;
    point_type _p3;
-   std::vector<triangle_ptr> _children;
-   bool _is_inside;
+   triangle_list _children;
+   region_id _region;
 };
 
-bool intersects(triangle_type const& t1, triangle_type const& t2);
+typedef basic_triangle<default_kernel> triangle_type;
+typedef basic_triangle_ptr<default_kernel> triangle_ptr;
+
+template<class Kernel>
+bool intersects(basic_triangle<Kernel> const& t1, basic_triangle<Kernel> const& t2);
 
-inline std::ostream& operator<<(std::ostream& ost, triangle_type const& t) {
-   ost << "triangle { " << t._p1 << " " << t._p2 << " " << t._p3 << " }: " << std::endl;
-   for(auto tr: t._children) {
-      ost << "      triangle { " << tr->_p1 << " " << tr->_p2 << " " << tr->_p3 << " }"
+template<class Kernel>
+std::ostream& operator<<(std::ostream& ost, basic_triangle<Kernel> const& t) {
+   ost << "triangle { " << t.p1() << " " << t.p2() << " " << t.p3() << " }: " << std::endl;
+   for(auto const& tr: t.children()) {
+      ost << "      triangle { " << tr->p1() << " " << tr->p2() << " " << tr->p3() << " }"
           << std::endl;
    }
    return ost;
 }
 
+template<class Kernel>
 template<class Cont>
-void triangle_type::add_children(Cont const& ts) {
+void basic_triangle<Kernel>::add_children(Cont const& ts) {
    _children.insert(_children.end(), ts.begin(), ts.end());
 }
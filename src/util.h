@@ -3,41 +3,21 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <cmath>
 #include "geom/primitives/point.h"
 #include "geom/primitives/segment.h"
 #include "io/point.h"
 #include "io/segment.h"
+#include "kernel.h"
 #include <vector>
 
 
 using geom::structures::point_type;
 using geom::structures::segment_type;
 
-#ifdef QT_DEBUG
-#define logger std::cerr
-#else
-struct null_stream: std::ostream {
-   null_stream(): std::ostream(new std::filebuf()) { }
-};
-
-static null_stream logger;
-
-// Ensure this operation doesn't cost us (almost) anything.
-template<class T>
-null_stream& operator<<(null_stream& ost, T const&) { return ost; }
-#endif
-
 typedef std::vector<point_type> point_arr;
 typedef std::vector<segment_type> segment_arr;
 
-// 1   1   1
-// p1x p2x p3x
-// p1y p2y p3y
-inline float determinant(point_type const& p1, point_type const& p2, point_type const& p3) {
-   return (p2.x * p3.y - p3.x * p2.y) - (p1.x * p3.y - p3.x * p1.y) +
-      (p1.x * p2.y - p2.x * p1.y);
-}
-
 template<class T>
 int sign(T t) {
    if(t < 0) return -1;
@@ -45,68 +25,122 @@ int sign(T t) {
    else return 1;
 }
 
-inline bool is_right_turn(point_type const& p1, point_type const& p2,
-      point_type const& p3) {
-   return determinant(p1, p2, p3) < 0;
+// The predicates below take the points of any kernel, orientation() is
+// resolved by the point type (see kernel.h).
+
+template<class Point>
+bool is_right_turn(Point const& p1, Point const& p2, Point const& p3) {
+   return orientation(p1, p2, p3) < 0;
 }
 
-inline bool is_left_turn(point_type const& p1, point_type const& p2,
-      point_type const& p3) {
-   return determinant(p1, p2, p3) > 0;
+template<class Point>
+bool is_left_turn(Point const& p1, Point const& p2, Point const& p3) {
+   return orientation(p1, p2, p3) > 0;
 }
 
-inline bool intersects(segment_type const& s1, segment_type const& s2) {
-   int r1 = sign(determinant(s1[0], s1[1], s2[0]));
-   int r2 = sign(determinant(s1[0], s1[1], s2[1]));
-   int r3 = sign(determinant(s2[0], s2[1], s1[0]));
-   int r4 = sign(determinant(s2[0], s2[1], s1[1]));
+template<class Point>
+bool segments_intersect(Point const& a1, Point const& a2, Point const& b1, Point const& b2) {
+   int r1 = orientation(a1, a2, b1);
+   int r2 = orientation(a1, a2, b2);
+   int r3 = orientation(b1, b2, a1);
+   int r4 = orientation(b1, b2, a2);
    return (r1 * r2 <= 0) && (r3 * r4 <= 0);
 }
 
+template<class Point>
+bool segments_intersect_inside(Point const& a1, Point const& a2, Point const& b1,
+      Point const& b2) {
+   if(a1 == b1 || a1 == b2 || a2 == b1 || a2 == b2) return false;
+   return segments_intersect(a1, a2, b1, b2);
+}
+
+inline bool intersects(segment_type const& s1, segment_type const& s2) {
+   return segments_intersect(s1[0], s1[1], s2[0], s2[1]);
+}
+
 inline bool intersects_inside(segment_type const& s1, segment_type const& s2) {
-   if(s1[0] == s2[0] || s1[0] == s2[1] || s1[1] == s2[0] || s1[1] == s2[1]) return false;
-   return intersects(s1, s2);
+   return segments_intersect_inside(s1[0], s1[1], s2[0], s2[1]);
+}
+
+template<class Point>
+bool intersects(kernel_segment<Point> const& s1, kernel_segment<Point> const& s2) {
+   return segments_intersect(s1[0], s1[1], s2[0], s2[1]);
 }
 
-inline bool is_counter_clockwise(point_arr const& points) {
+// The lowest of the leftmost points is a convex corner, the polygon turns
+// left there iff it is counter-clockwise.
+template<class Point>
+bool is_counter_clockwise(std::vector<Point> const& points) {
    size_t leftmost = 0;
    for(size_t i = 0; i != points.size(); ++i)
-      if(points[i].x < points[leftmost].x) leftmost = i;
+      if(points[i].x < points[leftmost].x ||
+            (points[i].x == points[leftmost].x && points[i].y < points[leftmost].y))
+         leftmost = i;
    size_t next = (leftmost + 1) % points.size();
    size_t prev = (points.size() + leftmost - 1) % points.size();
-   return points[prev].y > points[next].y;
+   return is_left_turn(points[prev], points[leftmost], points[next]);
 }
 
-inline bool is_visible(point_arr const& convex_hull, size_t i,
-      point_arr const& outer_points, size_t j) {
+template<class Point>
+bool is_visible(std::vector<Point> const& convex_hull, size_t i,
+      std::vector<Point> const& outer_points, size_t j) {
    return is_right_turn(outer_points[j], convex_hull[i],
          convex_hull[(i + 1) % convex_hull.size()]);
 }
 
-template<class Cont>
-point_arr sort_counter_clockwise(point_type const& pt, Cont const& points) {
-   point_arr res(points.size());
-   std::partial_sort_copy(points.begin(), points.end(), res.begin(), res.end(),
-         [&pt](point_type const& p1, point_type const& p2) {
-            double a1 = std::atan2(p1.y - pt.y, p1.x - pt.x);
-            double a2 = std::atan2(p2.y - pt.y, p2.x - pt.x);
-            return a1 < a2;
+// True if the direction from pt to p1 comes before the one to p2 in the
+// order of atan2, from just below the negative x axis round to it. Exact:
+// the half plane first, below pt before the rest, then the orientation.
+// Only the x axis holds opposite directions of one half, 0 before pi.
+template<class Point>
+bool angle_less(Point const& pt, Point const& p1, Point const& p2) {
+   bool const below1 = p1.y < pt.y, below2 = p2.y < pt.y;
+   if(below1 != below2) return below1;
+   int const o = orientation(pt, p1, p2);
+   if(o != 0) return o > 0;
+   return pt.x < p1.x && p2.x < pt.x;
+}
+
+template<class Point, class Cont>
+std::vector<Point> sort_counter_clockwise(Point const& pt, Cont const& points) {
+   std::vector<Point> res(points.begin(), points.end());
+   std::sort(res.begin(), res.end(), [&pt](Point const& p1, Point const& p2) {
+      return angle_less(pt, p1, p2);
    });
    return res;
 }
 
-inline bool inside_triangle(point_type const& p1, point_type const& p2,
-      point_type const& p3, point_type const& pt) {
-   int r1 = sign(determinant(pt, p2, p1));
-   int r2 = sign(determinant(pt, p3, p2));
-   int r3 = sign(determinant(pt, p1, p3));
+template<class Point>
+bool inside_triangle(Point const& p1, Point const& p2, Point const& p3, Point const& pt) {
+   int r1 = orientation(pt, p2, p1);
+   int r2 = orientation(pt, p3, p2);
+   int r3 = orientation(pt, p1, p3);
    return (r1 <= 0 && r2 <= 0 && r3 <= 0);
 }
 
-inline bool is_ear(point_type const& p1, point_type const& p2, point_type const& p3,
-      point_arr const& points) {
+// inside_triangle that tells the boundary apart and stops at the first edge
+// with pt outside: 0 outside, 1 on the boundary, 2 strictly inside. tests
+// grows by the number of orientations evaluated.
+template<class Point>
+int triangle_position(Point const& p1, Point const& p2, Point const& p3, Point const& pt,
+      int& tests) {
+   ++tests;
+   int r1 = orientation(pt, p2, p1);
+   if(r1 > 0) return 0;
+   ++tests;
+   int r2 = orientation(pt, p3, p2);
+   if(r2 > 0) return 0;
+   ++tests;
+   int r3 = orientation(pt, p1, p3);
+   if(r3 > 0) return 0;
+   return r1 == 0 || r2 == 0 || r3 == 0 ? 1 : 2;
+}
+
+template<class Point>
+bool is_ear(Point const& p1, Point const& p2, Point const& p3,
+      std::vector<Point> const& points) {
    if(!is_left_turn(p1, p2, p3)) return false;
-   for(auto pt: points) {
+   for(auto const& pt: points) {
       if(pt == p1 || pt == p2 || pt == p3) continue;
       if(inside_triangle(p1, p2, p3, pt)) return false;
    }
@@ -1,3 +1,4 @@
+#pragma comment( lib, "OpenGL32.lib" )
 #include <fstream>
 
 #include <boost/none.hpp>
@@ -19,12 +20,34 @@ kirkpatrick_viewer::kirkpatrick_viewer():
    _poly_complete(false),
    _query_hit(false) { }
 
+void draw_inside_triangles(drawer_type& drawer, triangle_ptr const& father) {
+   if(!father) return;
+   if(father->is_inside()) {
+      double width = 6;
+      drawer.set_color(Qt::yellow);
+      drawer.draw_line(father->p1(), father->p2(), width);
+      drawer.draw_line(father->p2(), father->p3(), width);
+      drawer.draw_line(father->p3(), father->p1(), width);
+   }
+   for(auto const& t: father->children()) {
+      draw_inside_triangles(drawer, t);
+   }
+}
+
+void draw_kirkpatrick(drawer_type& drawer, kirkpatrick_type const& kirkpatrick) {
+   drawer.set_color(Qt::blue);
+   for(auto segm: kirkpatrick.triangulation()) {
+      drawer.draw_line(segm[0], segm[1], 1);
+   }
+   draw_inside_triangles(drawer, kirkpatrick.top_triangle());
+}
+
 void kirkpatrick_viewer::draw(drawer_type& drawer) const {
    size_t pt_size = 4;
    size_t line_size = 1;
    if(_kirkpatrick)
    {
-       _kirkpatrick->draw(drawer);
+       draw_kirkpatrick(drawer, *_kirkpatrick);
        line_size=2;
    }
    if(!_points.empty()) {
@@ -107,7 +130,7 @@ bool kirkpatrick_viewer::on_move(point_type const &pos)
     _move_point = pos;
     if (_state == viewer_state::QUERY)  {
         _query_point = pos;
-        _query_hit = _kirkpatrick->query(pos);
+        _query_hit = _kirkpatrick->dag().query(pos, _cursor);
     }
     return true;
 }
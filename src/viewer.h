@@ -27,6 +27,7 @@ private:
    static int time_for_warning;
    // QUERY only
    boost::optional<kirkpatrick_type> _kirkpatrick;
+   query_cursor _cursor;                 // mouse moves are close to each other
    boost::optional<point_type> _query_point;
    bool _query_hit;
 };
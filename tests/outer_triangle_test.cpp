@@ -0,0 +1,71 @@
+// The exterior of a convex hull whose leftmost vertex is already the last
+// one to see the first outer vertex. The fan round the hull used to switch
+// to the next outer vertex one hull vertex late, and two exterior
+// triangles overlapped the hull. Answers are compared with a brute-force
+// test on every integer point around the polygon, for the plain build and
+// for one in a frame. A framed polygon with a hull too large for the top
+// level gets a ring round it too, its bounding box.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "kirkpatrick.h"
+
+namespace {
+
+// Closed point in polygon test, linear in the number of vertices.
+bool inside(point_arr const& poly, point_type const& pt) {
+   bool res = false;
+   for(size_t i = 0, j = poly.size() - 1; i != poly.size(); j = i++) {
+      point_type const& a = poly[j];
+      point_type const& b = poly[i];
+      int const o = orientation(a, b, pt);
+      if(o == 0 && std::min(a.x, b.x) <= pt.x && pt.x <= std::max(a.x, b.x) &&
+            std::min(a.y, b.y) <= pt.y && pt.y <= std::max(a.y, b.y))
+         return true;
+      if((a.y > pt.y) != (b.y > pt.y) && (b.y > a.y ? o > 0 : o < 0))
+         res = !res;
+   }
+   return res;
+}
+
+size_t mismatches(kirkpatrick_type const& k, point_arr const& poly, char const* what) {
+   point_type lo = poly[0], hi = poly[0];
+   for(auto const& pt: poly) {
+      lo = point_type(std::min(lo.x, pt.x), std::min(lo.y, pt.y));
+      hi = point_type(std::max(hi.x, pt.x), std::max(hi.y, pt.y));
+   }
+   size_t res = 0;
+   for(int32_t x = lo.x - 10; x <= hi.x + 10; ++x) {
+      for(int32_t y = lo.y - 10; y <= hi.y + 10; ++y) {
+         point_type const pt(x, y);
+         if(k.query(pt) == inside(poly, pt)) continue;
+         if(++res <= 5) std::printf("%s: wrong answer at (%d, %d)\n", what, x, y);
+      }
+   }
+   return res;
+}
+
+} // namespace
+
+int main() {
+   // Zone 25 of make_zones(1000) in bench/polygon_generators.h.
+   point_arr const poly = { { 890, -4 }, { 903, -1 }, { 917, 0 }, { 930, 5 }, { 927, 14 },
+         { 922, 23 }, { 922, 32 }, { 914, 28 }, { 907, 27 }, { 899, 26 }, { 899, 16 },
+         { 890, 6 } };
+   size_t failures = mismatches(kirkpatrick_type(poly), poly, "plain");
+   failures += mismatches(kirkpatrick_type(poly, point_type(0, -1000), point_type(2000, 1000)),
+         poly, "framed");
+   // 40 vertices on a circle, every other one pulled in.
+   point_arr wheel;
+   for(int i = 0; i != 40; ++i) {
+      double const r = i % 2 ? 50 : 40, a = i * 2 * M_PI / 40;
+      wheel.push_back(point_type(int32_t(std::lround(r * std::cos(a))),
+            int32_t(std::lround(r * std::sin(a)))));
+   }
+   failures += mismatches(kirkpatrick_type(wheel, point_type(-500, -500), point_type(500, 500)),
+         wheel, "framed, large hull");
+   std::printf("%zu wrong answers\n", failures);
+   return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Orientation predicates against exact integer arithmetic: random and
+// near-collinear triples through the int32, int64, double and float
+// overloads, and grids of almost collinear doubles where the filter of the
+// double overload gives up and the exact expansion decides.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include "predicates.h"
+
+namespace {
+
+typedef boost::multiprecision::int256_t big;       // the products take 130 bits
+
+size_t failures = 0;
+
+int reference(big ax, big ay, big bx, big by, big cx, big cy) {
+   big const det = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+   return det > 0 ? 1 : det < 0 ? -1 : 0;
+}
+
+void expect(int got, int want, char const* what, double ax, double ay, double bx, double by,
+      double cx, double cy) {
+   if(got == want) return;
+   if(++failures <= 10) {
+      std::printf("%s: got %d, want %d for (%.17g %.17g) (%.17g %.17g) (%.17g %.17g)\n", what,
+            got, want, ax, ay, bx, by, cx, cy);
+   }
+}
+
+// c on the line through a and b, k steps of b - a away, then moved by up
+// to one unit, if it stays in range.
+template<class T, class Gen>
+void near_collinear(T const a[2], T const b[2], T c[2], Gen& gen) {
+   std::uniform_int_distribution<int> step(-2, 2), nudge(-1, 1);
+   big const k = step(gen);
+   big const x = big(a[0]) + k * (big(b[0]) - big(a[0])) + nudge(gen);
+   big const y = big(a[1]) + k * (big(b[1]) - big(a[1])) + nudge(gen);
+   big const lo = std::numeric_limits<T>::min(), hi = std::numeric_limits<T>::max();
+   if(lo <= x && x <= hi && lo <= y && y <= hi) {
+      c[0] = static_cast<T>(x);
+      c[1] = static_cast<T>(y);
+   }
+}
+
+template<class T>
+void random_triples(char const* what, size_t count, uint64_t seed) {
+   std::mt19937_64 gen(seed);
+   std::uniform_int_distribution<T> full(std::numeric_limits<T>::min(),
+         std::numeric_limits<T>::max()), small(-1000, 1000);
+   for(size_t i = 0; i != count; ++i) {
+      T p[3][2];
+      for(auto& q: p) for(auto& v: q) v = i % 3 == 0 ? small(gen) : full(gen);
+      if(i % 2) near_collinear(p[0], p[1], p[2], gen);
+      int const want = reference(p[0][0], p[0][1], p[1][0], p[1][1], p[2][0], p[2][1]);
+      expect(predicates::orientation(p[0][0], p[0][1], p[1][0], p[1][1], p[2][0], p[2][1]),
+            want, what, double(p[0][0]), double(p[0][1]), double(p[1][0]), double(p[1][1]),
+            double(p[2][0]), double(p[2][1]));
+      // Coordinates of 53 bits and less are exact as doubles.
+      bool exact = true;
+      for(auto& q: p) for(auto& v: q) exact = exact && std::abs(double(v)) < 0x1p53;
+      if(!exact) continue;
+      double d[3][2];
+      for(int j = 0; j != 3; ++j) for(int k = 0; k != 2; ++k) d[j][k] = double(p[j][k]);
+      expect(predicates::orientation(d[0][0], d[0][1], d[1][0], d[1][1], d[2][0], d[2][1]),
+            want, "double", d[0][0], d[0][1], d[1][0], d[1][1], d[2][0], d[2][1]);
+      expect(predicates::orientation_exact(d[0][0], d[0][1], d[1][0], d[1][1], d[2][0], d[2][1]),
+            want, "double exact", d[0][0], d[0][1], d[1][0], d[1][1], d[2][0], d[2][1]);
+   }
+}
+
+// The double as an integer number of 2^-53, exact for the grid below.
+big scaled(double v) {
+   return big(static_cast<int64_t>(std::ldexp(v, 53)));
+}
+
+bool filter_decides(double ax, double ay, double bx, double by, double cx, double cy) {
+   double const eps = std::numeric_limits<double>::epsilon() / 2;
+   double const left = (ax - cx) * (by - cy), right = (ay - cy) * (bx - cx);
+   return std::fabs(left - right) >= (3 + 16 * eps) * eps * (std::fabs(left) + std::fabs(right));
+}
+
+// Shewchuk's example: a runs over a 256 x 256 grid of neighbouring doubles
+// next to (0.5, 0.5), b and c are (12, 12) and (24, 24). Most of these are
+// too close to collinear for the filter. Returns how often it gave up.
+size_t filter_failures() {
+   size_t undecided = 0;
+   double const b[2] = { 12, 12 }, c[2] = { 24, 24 };
+   for(int i = 0; i != 256; ++i) {
+      for(int j = 0; j != 256; ++j) {
+         double const ax = 0.5 + std::ldexp(double(i), -53);
+         double const ay = 0.5 + std::ldexp(double(j), -53);
+         int const want = reference(scaled(ax), scaled(ay), scaled(b[0]), scaled(b[1]),
+               scaled(c[0]), scaled(c[1]));
+         undecided += !filter_decides(ax, ay, b[0], b[1], c[0], c[1]);
+         expect(predicates::orientation(ax, ay, b[0], b[1], c[0], c[1]), want, "grid",
+               ax, ay, b[0], b[1], c[0], c[1]);
+         expect(predicates::orientation(b[0], b[1], c[0], c[1], ax, ay), want, "grid rotated",
+               b[0], b[1], c[0], c[1], ax, ay);
+         expect(predicates::orientation(c[0], c[1], ax, ay, b[0], b[1]), want, "grid rotated",
+               c[0], c[1], ax, ay, b[0], b[1]);
+      }
+   }
+   return undecided;
+}
+
+} // namespace
+
+int main() {
+   random_triples<int32_t>("int32", 2000000, 5);
+   random_triples<int64_t>("int64", 500000, 6);
+   // Floats widen to doubles exactly.
+   {
+      std::mt19937 gen(7);
+      std::uniform_int_distribution<int32_t> coord(-(1 << 24), 1 << 24);
+      for(size_t i = 0; i != 200000; ++i) {
+         float p[6];
+         for(auto& v: p) v = float(coord(gen));
+         if(i % 2) p[4] = p[0] + 2 * (p[2] - p[0]), p[5] = p[1] + 2 * (p[3] - p[1]);
+         int const want = reference(int64_t(p[0]), int64_t(p[1]), int64_t(p[2]),
+               int64_t(p[3]), int64_t(p[4]), int64_t(p[5]));
+         if(std::abs(p[4]) < 0x1p24 && std::abs(p[5]) < 0x1p24)
+            expect(predicates::orientation(p[0], p[1], p[2], p[3], p[4], p[5]), want, "float",
+                  p[0], p[1], p[2], p[3], p[4], p[5]);
+      }
+   }
+   size_t const undecided = filter_failures();
+   if(undecided == 0) {
+      std::printf("the grid never reached the exact fallback\n");
+      ++failures;
+   }
+   std::printf("%zu failures, filter undecided on %zu of 65536 grid points\n", failures,
+         undecided);
+   return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Answers on fixed inputs against the hashes they had when the test was
+// written: the three sample polygons of the viewer, queried on a grid, and
+// generated polygons, subdivisions and atlases of bench/polygon_generators.h,
+// queried at generated points. Every input is built with one and with four
+// threads, and answered one point at a time and in batches.
+//
+//    regression_test SOURCE_DIR [--print]
+//
+// --print writes the hashes of the current tree in the form of the table
+// below, for when answers change on purpose. A generated input has a hash
+// of its own, so that a change of the generators (or of the random
+// distributions of the standard library) is told apart from one of the
+// answers.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "atlas.h"
+#include "kirkpatrick.h"
+#include "polygon_generators.h"
+
+namespace {
+
+struct expected {
+   char const* name;
+   uint64_t input, answers;
+};
+
+// The sample files are read as they are, only their answers are hashed.
+expected const table[] = {
+   { "Big_Subdivisition", 0x0, 0xbddda0a92c2feba4 },
+   { "Big_Subdivisition_Heavy", 0x0, 0x2ab60b267303abdf },
+   { "file_test", 0x0, 0xc4994020c72525e8 },
+   { "polygon/star", 0xd54c34b066c0a6bd, 0xc0b489a67deb0182 },
+   { "polygon/spiral", 0x1561623c8ddbe34f, 0x9068eb6ed891a61b },
+   { "polygon/comb", 0x5b0a7b6677754690, 0xa473ad33e061fbd },
+   { "polygon/reflex", 0xcc3284c02e03a464, 0xceb86f60c0e08548 },
+   { "subdivision/zones", 0x117eea17ec4fdc92, 0xe86e66510a7e4f0d },
+   { "atlas/zones", 0x117eea17ec4fdc92, 0xc9099564ae1bbd9 },
+};
+
+struct hasher {
+   uint64_t value = 0;
+   void add(int64_t v) { value = value * 31 + uint64_t(v); }
+   void add(point_arr const& pts) {
+      for(auto const& pt: pts) {
+         add(pt.x);
+         add(pt.y);
+      }
+   }
+};
+
+bool print = false;
+size_t failures = 0;
+
+void check(std::string const& name, uint64_t input, uint64_t answers) {
+   if(print) {
+      std::printf("   { \"%s\", 0x%llx, 0x%llx },\n", name.c_str(), (unsigned long long)input,
+            (unsigned long long)answers);
+      return;
+   }
+   for(auto const& e: table) {
+      if(name != e.name) continue;
+      if(e.input != input) {
+         std::printf("%s: the input changed, hash %llx\n", name.c_str(),
+               (unsigned long long)input);
+         ++failures;
+      } else if(e.answers != answers) {
+         std::printf("%s: answers changed, hash %llx\n", name.c_str(),
+               (unsigned long long)answers);
+         ++failures;
+      }
+      return;
+   }
+   std::printf("%s: no hash recorded\n", name.c_str());
+   ++failures;
+}
+
+// A point on the boundary of regions may get any of them, and builds on
+// several threads order the children differently, so those points only
+// count as on the boundary. Batches must answer like single points.
+int64_t answer(kirkpatrick_type const& k, point_type const& pt, region_id region) {
+   return k.dag().on_boundary(pt) ? -2 : region;
+}
+
+uint64_t answers(std::string const& name, kirkpatrick_type const& k, point_arr const& pts) {
+   hasher h, batch;
+   std::vector<region_id> regions(pts.size());
+   k.locate_batch(pts.data(), pts.size(), regions.data());
+   for(size_t i = 0; i != pts.size(); ++i) {
+      h.add(answer(k, pts[i], k.locate(pts[i])));
+      batch.add(answer(k, pts[i], regions[i]));
+   }
+   if(batch.value != h.value) {
+      std::printf("%s: batches answer differently\n", name.c_str());
+      ++failures;
+   }
+   return h.value;
+}
+
+// The atlas answers the smallest id, boundary or not. It has no batches.
+uint64_t answers(std::string const&, polygon_atlas_type const& atlas, point_arr const& pts) {
+   hasher h;
+   for(auto const& pt: pts) h.add(atlas.locate(pt));
+   return h.value;
+}
+
+template<class Structure, class... Args>
+uint64_t build_and_answer(std::string const& name, point_arr const& pts, Args const&... args) {
+   build_options options;
+   uint64_t res = answers(name, Structure(args..., options), pts);
+   options.threads = 4;
+   if(answers(name, Structure(args..., options), pts) != res) {
+      std::printf("%s: four threads build a different structure\n", name.c_str());
+      ++failures;
+   }
+   return res;
+}
+
+// The viewer's format, see kirkpatrick_cli.
+point_arr read_polygon(std::string const& path) {
+   std::ifstream ifs(path.c_str());
+   bool complete = false;
+   ifs >> complete;
+   return point_arr((std::istream_iterator<point_type>(ifs)), std::istream_iterator<point_type>());
+}
+
+// The sample polygons, 0/1 on a grid of step 3 over [-600, 600]^2 as
+// the viewer shows it. The hash is of query(), the threads and batches are
+// compared on locate() as for the generated inputs.
+void samples(std::string const& dir) {
+   point_arr grid;
+   for(int32_t x = -600; x <= 600; x += 3) {
+      for(int32_t y = -600; y <= 600; y += 3) grid.push_back(point_type(x, y));
+   }
+   for(char const* name: { "Big_Subdivisition", "Big_Subdivisition_Heavy", "file_test" }) {
+      point_arr const poly = read_polygon(dir + "/" + name);
+      if(poly.size() < 3) {
+         std::printf("%s: cannot read %s/%s\n", name, dir.c_str(), name);
+         ++failures;
+         continue;
+      }
+      kirkpatrick_type const k(poly);
+      hasher h;
+      for(auto const& pt: grid) h.add(k.query(pt));
+      build_and_answer<kirkpatrick_type>(name, grid, poly);
+      check(name, 0, h.value);
+   }
+}
+
+point_arr queries_for(point_arr const& poly) {
+   point_arr res = make_queries(poly, query_distribution::uniform, 10000);
+   point_arr const boundary = make_queries(poly, query_distribution::boundary, 10000);
+   res.insert(res.end(), boundary.begin(), boundary.end());
+   return res;
+}
+
+void generated() {
+   for(auto shape: all_shapes()) {
+      point_arr const poly = make_polygon(shape, 2000);
+      point_arr const pts = queries_for(poly);
+      hasher input;
+      input.add(poly);
+      input.add(pts);
+      std::string const name = std::string("polygon/") + to_string(shape);
+      check(name, input.value, build_and_answer<kirkpatrick_type>(name, pts, poly));
+   }
+   std::vector<point_arr> const zones = make_zones(400);
+   point_arr all;
+   hasher input;
+   for(auto const& z: zones) {
+      input.add(z);
+      all.insert(all.end(), z.begin(), z.end());
+   }
+   point_arr const pts = queries_for(all);
+   input.add(pts);
+   check("subdivision/zones", input.value,
+         build_and_answer<kirkpatrick_type>("subdivision/zones", pts, zones));
+   point_type min = all[0], max = all[0];
+   for(auto const& pt: all) {
+      min = point_type(std::min(min.x, pt.x), std::min(min.y, pt.y));
+      max = point_type(std::max(max.x, pt.x), std::max(max.y, pt.y));
+   }
+   check("atlas/zones", input.value,
+         build_and_answer<polygon_atlas_type>("atlas/zones", pts, min, max, zones));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+   if(argc < 2) {
+      std::fprintf(stderr, "usage: regression_test SOURCE_DIR [--print]\n");
+      return 2;
+   }
+   print = argc > 2 && std::strcmp(argv[2], "--print") == 0;
+   samples(argv[1]);
+   generated();
+   if(!print) std::printf("%zu failures\n", failures);
+   return failures == 0 ? 0 : 1;
+}
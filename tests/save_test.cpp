@@ -0,0 +1,40 @@
+// Saving over the file a loaded DAG maps. save() used to rewrite the file
+// in place, so the loaded DAG lost its pages (SIGBUS for a smaller image)
+// or read a torn one. Now the loaded DAG keeps answering from the old
+// image, and a new load() gets the new one.
+
+#include <cstdio>
+#include <string>
+
+#include "kirkpatrick.h"
+#include "polygon_generators.h"
+
+namespace {
+
+size_t mismatches(flat_dag_type const& dag, kirkpatrick_type const& k, point_arr const& pts) {
+   size_t res = 0;
+   for(auto const& pt: pts) res += dag.locate(pt) != k.locate(pt);
+   return res;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+   std::string const path = std::string(argc > 1 ? argv[1] : ".") + "/save_test.dag";
+   point_arr const large = make_polygon(polygon_shape::star, 20000);
+   point_arr const small = make_polygon(polygon_shape::star, 50);
+   point_arr const pts = make_queries(large, query_distribution::uniform, 20000);
+   kirkpatrick_type const big(large), little(small);
+   big.save(path);
+   flat_dag_type const loaded = flat_dag_type::load(path);
+   little.save(path);                        // smaller, then larger again
+   size_t failures = mismatches(loaded, big, pts);
+   flat_dag_type const reloaded = flat_dag_type::load(path);
+   failures += mismatches(reloaded, little, pts);
+   big.save(path);
+   failures += mismatches(loaded, big, pts) + mismatches(reloaded, little, pts);
+   failures += mismatches(flat_dag_type::load(path), big, pts);
+   std::remove(path.c_str());
+   std::printf("%zu wrong answers\n", failures);
+   return failures == 0 ? 0 : 1;
+}